@@ -0,0 +1,136 @@
+// Re-solve Bi-MDF networks dumped by the flow quantization (FlowConfig::dump_prefix)
+// to compare satsuma configurations without running the whole pipeline.
+
+#include <quadretopology/qr_bimdf_io.h>
+
+#include <libsatsuma/Extra/Highlevel.hh>
+#include <libsatsuma/Extra/json.hh>
+#include <libTimekeeper/StopWatch.hh>
+#include <libTimekeeper/json.hh>
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+Satsuma::BiMDFSolverConfig loadSolverConfig(const std::string& filename)
+{
+    Satsuma::BiMDFSolverConfig config;
+    if (filename.empty()) {
+        return config;
+    }
+    std::ifstream f(filename);
+    if (!f.good()) {
+        throw std::runtime_error("Could not open satsuma config file '" + filename + "'");
+    }
+    nlohmann::json j;
+    f >> j;
+    config = j;
+    return config;
+}
+
+nlohmann::json timeDistribution(std::vector<double> seconds)
+{
+    std::sort(seconds.begin(), seconds.end());
+    const size_t n = seconds.size();
+    const double median = n % 2 ? seconds[n / 2] : .5 * (seconds[n / 2 - 1] + seconds[n / 2]);
+    return {
+        {"min", seconds.front()},
+        {"median", median},
+        {"mean", std::accumulate(seconds.begin(), seconds.end(), 0.) / n},
+        {"max", seconds.back()}};
+}
+
+} // namespace
+
+int actual_main(int argc, char *argv[])
+{
+    if (argc < 5) {
+        std::cerr << "usage: " << argv[0]
+                  << " <satsuma_config.json|\"\"> <repetitions> <out.json> <instance.bimdf>..."
+                  << std::endl;
+        return 1;
+    }
+    const std::string config_filename = argv[1];
+    const int repetitions = std::atoi(argv[2]);
+    const std::string json_filename = argv[3];
+    if (repetitions < 1) {
+        throw std::runtime_error("repetitions must be positive");
+    }
+
+    const auto config = loadSolverConfig(config_filename);
+
+    auto json = nlohmann::json{
+        {"satsuma_config", config_filename.empty() ? "default" : config_filename},
+        {"repetitions", repetitions},
+        {"instances", nlohmann::json::array()}};
+
+    for (int i = 4; i < argc; ++i) {
+        const std::string filename = argv[i];
+        const auto instance = QuadRetopology::loadBiMDFInstance(filename);
+        const auto bimdf = instance.to_bimdf();
+        std::cout << filename << ": " << instance.n_nodes << " nodes, "
+                  << instance.edges.size() << " edges" << std::endl;
+
+        std::vector<double> seconds;
+        auto runs = nlohmann::json::array();
+        double cost = 0.;
+        for (int rep = 0; rep < repetitions; ++rep) {
+            const auto start = std::chrono::steady_clock::now();
+            auto res = Satsuma::solve_bimdf(*bimdf, config, nullptr);
+            seconds.push_back(std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count());
+            if (!bimdf->is_valid(*res.solution)) {
+                throw std::runtime_error(filename + ": solution invalid");
+            }
+            const double run_cost = bimdf->cost(*res.solution) + instance.cost_offset;
+            if (rep > 0 && run_cost != cost) {
+                std::cout << "\tcost differs between runs: " << cost << " vs " << run_cost << std::endl;
+            }
+            cost = run_cost;
+            runs.push_back({
+                    {"seconds", seconds.back()},
+                    {"cost", run_cost},
+                    {"stopwatch", res.stopwatch}});
+        }
+        const auto distribution = timeDistribution(seconds);
+        std::cout << "\tcost " << cost << ", median " << distribution["median"] << " s" << std::endl;
+
+        auto groups = nlohmann::json::object();
+        for (const auto& [name, edges]: instance.edge_groups) {
+            groups[name] = edges.size();
+        }
+        json["instances"].push_back({
+                {"filename", filename},
+                {"nodes", instance.n_nodes},
+                {"edges", instance.edges.size()},
+                {"edge_groups", groups},
+                {"cost", cost},
+                {"seconds", distribution},
+                {"runs", runs}});
+    }
+
+    std::ofstream json_file{json_filename};
+    json_file << std::setw(4) << json;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        return actual_main(argc, argv);
+    }
+    catch (std::exception& e) {
+        std::cerr << "fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+}
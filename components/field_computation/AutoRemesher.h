@@ -35,8 +35,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <vcg/space/index/grid_static_ptr.h>
 #include <vcg/complex/algorithms/closest.h>
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse.h>
+#include <vcg/complex/algorithms/stat.h>
+#include <vcg/complex/algorithms/update/selection.h>
 
+#include <quadretopology/includes/qr_parallel.h>
+
+#include "face_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <set>
 
 template <class Mesh>
 class AutoRemesher {
@@ -52,12 +64,21 @@ class AutoRemesher {
 
     typedef vcg::GridStaticPtr<FaceType, ScalarType> StaticGrid;
 
-    static ScalarType computeAR(Mesh & m, const double perc = 0.05)
+    //vcg::QualityRadii of every face in its quality, see FaceGeometry
+    static void UpdateQualityRadii(Mesh & m, const int numThreads = 1)
     {
-        vcg::tri::ForEachFace(m, [] (FaceType & f) {
-            f.Q() = vcg::QualityRadii(f.cP(0), f.cP(1), f.cP(2));
-            //std::cout<<"Q:"<<f.Q()<<std::endl;
-        });
+        typename vcg::tri::FaceGeometry<Mesh>::Snapshot S;
+        typename vcg::tri::FaceGeometry<Mesh>::ArrayX Q;
+        vcg::tri::FaceGeometry<Mesh>::Update(m, S, numThreads);
+        vcg::tri::FaceGeometry<Mesh>::QualityRadii(S, Q, numThreads);
+        for (size_t i=0;i<m.face.size();i++)
+            if (!m.face[i].IsD())
+                m.face[i].Q() = Q[i];
+    }
+
+    static ScalarType computeAR(Mesh & m, const double perc = 0.05, const int numThreads = 1)
+    {
+        UpdateQualityRadii(m, numThreads);
 
         vcg::Histogram<ScalarType> hist;
         vcg::tri::Stat<Mesh>::ComputePerFaceQualityHistogram(m, hist);
@@ -183,8 +204,179 @@ public:
         ScalarType maxAdaptiveMult = 3;
         ScalarType minAspectRatioThr = 0.05;
         ScalarType targetEdgeLen = 0;
+        //allowed distance from the input surface, 0: bbox diagonal / 2500 of the mesh passed to
+        //RemeshAdapt. Set from the whole mesh when only a part of it is remeshed (see RemeshTile)
+        ScalarType maxSurfDist = 0;
+        //remesh spatial tiles in parallel (0: one thread per core), see ParallelRemesh
+        int numThreads = 1;
+        //only remesh the selected faces, see RemeshTile
+        bool selectedOnly = false;
     } Params;
 
+    //Splits every vertex whose incident faces form more than one fan, fans being connected through
+    //manifold edges (exactly two faces), so non manifold edges and vertices are opened in one go.
+    //Edges are matched in a single flat table sorted by their vertices instead of the FF topology,
+    //and the fans are found in parallel over the vertices. The first fan keeps the vertex, each new
+    //one is moved towards its fan by moveThreshold as in openNonManifoldEdges. Returns the number
+    //of vertices added, FF/VF topology is left to the caller.
+    static size_t RepairNonManifold(Mesh & m, const ScalarType moveThreshold,
+                                    const int numThreads=1, bool debugMesg=false)
+    {
+        const size_t None=std::numeric_limits<size_t>::max();
+        vcg::tri::Allocator<Mesh>::CompactEveryVector(m);
+        const size_t nV=m.vert.size();
+        const size_t nC=3*m.face.size();
+        assert(nV<(size_t(1)<<32));
+
+        //corner c of face f is 3*f+c, its edge goes from V(c) to V((c+1)%3)
+        std::vector<size_t> cornerV(nC);
+        for (size_t i=0;i<m.face.size();i++)
+            for (int j=0;j<3;j++)
+                cornerV[3*i+j]=vcg::tri::Index(m,m.face[i].V(j));
+
+        std::vector<std::pair<uint64_t,size_t> > edges;
+        edges.reserve(nC);
+        for (size_t c=0;c<nC;c++)
+        {
+            const size_t v0=cornerV[c];
+            const size_t v1=cornerV[c-c%3+(c+1)%3];
+            if (v0==v1)continue;
+            edges.push_back(std::make_pair((uint64_t(std::min(v0,v1))<<32)|std::max(v0,v1),c));
+        }
+        std::sort(edges.begin(),edges.end());
+
+        //the corner across each manifold edge, None on borders and non manifold edges
+        std::vector<size_t> edgeMate(nC,None);
+        size_t nonManifoldE=0;
+        for (size_t b=0;b<edges.size();)
+        {
+            size_t e=b;
+            while ((e<edges.size())&&(edges[e].first==edges[b].first))e++;
+            if (e-b==2)
+            {
+                edgeMate[edges[b].second]=edges[b+1].second;
+                edgeMate[edges[b+1].second]=edges[b].second;
+            }
+            else if (e-b>2)
+                nonManifoldE++;
+            b=e;
+        }
+        std::vector<std::pair<uint64_t,size_t> >().swap(edges);
+
+        //corners of each vertex, in increasing order
+        std::vector<size_t> vOffset(nV+1,0);
+        for (size_t c=0;c<nC;c++)
+            vOffset[cornerV[c]+1]++;
+        for (size_t i=0;i<nV;i++)
+            vOffset[i+1]+=vOffset[i];
+        std::vector<size_t> vCorners(nC);
+        {
+            std::vector<size_t> pos(vOffset.begin(),vOffset.end()-1);
+            for (size_t c=0;c<nC;c++)
+                vCorners[pos[cornerV[c]]++]=c;
+        }
+
+        //fan of each corner within its vertex, numbered by their first corner
+        std::vector<size_t> cornerFan(nC,0);
+        std::vector<size_t> numFans(nV,0);
+        const size_t blockSize=1024;
+        const size_t numBlocks=(nV+blockSize-1)/blockSize;
+        struct Scratch
+        {
+            std::vector<size_t> parent;
+            std::vector<size_t> fanOf;
+        };
+        std::vector<Scratch> scratch(QuadRetopology::internal::numWorkerThreads(numThreads,numBlocks));
+        QuadRetopology::internal::parallelForWorkers(numBlocks,numThreads,[&](const size_t block,const size_t worker)
+        {
+            std::vector<size_t> & parent=scratch[worker].parent;
+            std::vector<size_t> & fanOf=scratch[worker].fanOf;
+            for (size_t v=block*blockSize;v<std::min(nV,(block+1)*blockSize);v++)
+            {
+                const size_t begin=vOffset[v];
+                const size_t end=vOffset[v+1];
+                parent.resize(end-begin);
+                for (size_t i=0;i<parent.size();i++)
+                    parent[i]=i;
+                auto find=[&](size_t i)
+                {
+                    while (parent[i]!=i)
+                        i=parent[i]=parent[parent[i]];
+                    return i;
+                };
+
+                for (size_t i=begin;i<end;i++)
+                {
+                    const size_t c=vCorners[i];
+                    //the two edges of the face incident to v
+                    const size_t edgeC[2]={c,c-c%3+(c+2)%3};
+                    for (int k=0;k<2;k++)
+                    {
+                        const size_t mate=edgeMate[edgeC[k]];
+                        if (mate==None)continue;
+                        //the corner at v of the face across
+                        size_t other=mate;
+                        if (cornerV[other]!=v)
+                            other=mate-mate%3+(mate+1)%3;
+                        const size_t j=std::lower_bound(vCorners.begin()+begin,vCorners.begin()+end,other)-vCorners.begin();
+                        parent[find(i-begin)]=find(j-begin);
+                    }
+                }
+
+                size_t fans=0;
+                fanOf.assign(end-begin,None);
+                for (size_t i=begin;i<end;i++)
+                {
+                    const size_t root=find(i-begin);
+                    if (fanOf[root]==None)
+                        fanOf[root]=fans++;
+                    cornerFan[vCorners[i]]=fanOf[root];
+                }
+                numFans[v]=fans;
+            }
+        });
+
+        size_t newV=0;
+        size_t splitV=0;
+        for (size_t v=0;v<nV;v++)
+        {
+            if (numFans[v]<=1)continue;
+            newV+=numFans[v]-1;
+            splitV++;
+        }
+        if ((debugMesg)||(newV>0))
+            std::cout << "Non manifold repair: " << nonManifoldE << " non manifold edges, "
+                      << splitV << " vertices split into " << newV << " new ones" << std::endl;
+        if (newV==0)return 0;
+
+        vcg::tri::Allocator<Mesh>::AddVertices(m,newV);
+        size_t next=nV;
+        std::vector<CoordType> delta;
+        std::vector<size_t> count;
+        for (size_t v=0;v<nV;v++)
+        {
+            if (numFans[v]<=1)continue;
+            delta.assign(numFans[v],CoordType(0,0,0));
+            count.assign(numFans[v],0);
+            const CoordType P=m.vert[v].cP();
+            for (size_t i=vOffset[v];i<vOffset[v+1];i++)
+            {
+                const size_t c=vCorners[i];
+                const size_t fan=cornerFan[c];
+                if (fan==0)continue;
+                const size_t f=c/3;
+                //barycenter with the positions before the split
+                delta[fan]+=(m.vert[cornerV[3*f]].cP()+m.vert[cornerV[3*f+1]].cP()+m.vert[cornerV[3*f+2]].cP())/3-P;
+                count[fan]++;
+                m.face[f].V(c%3)=&m.vert[next+fan-1];
+            }
+            for (size_t fan=1;fan<numFans[v];fan++)
+                m.vert[next+fan-1].P()=P+delta[fan]*(moveThreshold/count[fan]);
+            next+=numFans[v]-1;
+        }
+        return newV;
+    }
+
     static size_t openNonManifoldEdges(Mesh & m, const ScalarType moveThreshold,
                                        bool debugMesg=false)
     {
@@ -314,8 +506,15 @@ public:
                                     size_t TargetSph=2000,
                                     size_t MinFaces=10000)
     {
-        ScalarType Vol=m.Volume();
-        ScalarType A=m.Area();
+        return ExpectedEdgeL(m.Volume(),m.Area(),TargetSph,MinFaces);
+    }
+
+    //same as above from the volume and area, for meshes that are not loaded as a whole
+    static ScalarType ExpectedEdgeL(const ScalarType Vol,
+                                    const ScalarType A,
+                                    size_t TargetSph=2000,
+                                    size_t MinFaces=10000)
+    {
         ScalarType FaceA=A/TargetSph;
         //radius and volume of a sphere
         ScalarType Sphericity=(pow(M_PI,1.0/3.0)*pow((6.0*Vol),2.0/3.0))/A;
@@ -336,14 +535,22 @@ public:
     {
         if (par.creaseAngle<=0)return;
         m.UpdateDataStructures();
+
+        //cosine of the dihedral angles, borders are above any threshold
+        typename vcg::tri::FaceGeometry<Mesh>::Snapshot S;
+        typename vcg::tri::FaceGeometry<Mesh>::ArrayX N[3], D[3];
+        vcg::tri::FaceGeometry<Mesh>::Update(m, S, par.numThreads, true);
+        vcg::tri::FaceGeometry<Mesh>::Normals(S, N, par.numThreads);
+        vcg::tri::FaceGeometry<Mesh>::NormalDots(S, N, D, par.numThreads);
+        const ScalarType cosThr = std::cos(vcg::math::ToRad(par.creaseAngle));
+
         //std::set<std::pair<CoordType,CoordType> > Features;
         for (size_t i=0;i<m.face.size();i++)
             for (size_t j=0;j<3;j++)
             {
                 if (!m.face[i].IsFaceEdgeS(j))continue;
 
-                ScalarType angle = DihedralAngleRad(m.face[i],j);
-                if(fabs(angle)<vcg::math::ToRad(par.creaseAngle))
+                if(D[j][i]>cosThr)
                 {
                     if (vcg::face::IsBorder(m.face[i],j))continue;
                     m.face[i].ClearFaceEdgeS(j);
@@ -356,7 +563,357 @@ public:
 
     }
 
-    //for big meshes disabling par.surfDistCheck provides big perf improvements, sacrificing result accuracy
+    typedef typename vcg::tri::IsotropicRemeshing<Mesh>::Params RemeshParams;
+
+    //read-only copy of the surface before remeshing, with its spatial index. All the passes
+    //and tiles project on it and check their distance to it, so the deviation from the input
+    //does not add up over the passes
+    struct Reference
+    {
+        Mesh mesh;
+        StaticGrid grid;
+    };
+
+    static void InitReference(Mesh & m, Reference & ref)
+    {
+        vcg::tri::Append<Mesh, Mesh>::MeshCopy(ref.mesh, m);
+        vcg::tri::UpdateBounding<Mesh>::Box(ref.mesh);
+        vcg::tri::UpdateNormal<Mesh>::PerVertexNormalizedPerFaceNormalized(ref.mesh);
+        ref.grid.Set(ref.mesh.face.begin(), ref.mesh.face.end());
+    }
+
+    //copy of the reference faces touching box. The closest point queries mark the faces
+    //they visit, so the tiles remeshed in parallel each project on their own piece.
+    //refToPiece is scratch space of ref.mesh.vert.size() entries at -1, and is left so
+    static void ExtractReference(Reference & ref, const vcg::Box3<ScalarType> & box,
+                                 std::vector<int> & refToPiece, Mesh & piece)
+    {
+        std::vector<FaceType*> faces;
+        vcg::tri::GetInBoxFace(ref.mesh, ref.grid, box, faces);
+
+        std::vector<size_t> verts;
+        for (size_t i=0;i<faces.size();i++)
+            for (int j=0;j<3;j++)
+            {
+                size_t vi=vcg::tri::Index(ref.mesh,faces[i]->V(j));
+                if (refToPiece[vi]>=0)continue;
+                refToPiece[vi]=verts.size();
+                verts.push_back(vi);
+            }
+
+        vcg::tri::Allocator<Mesh>::AddVertices(piece,verts.size());
+        vcg::tri::Allocator<Mesh>::AddFaces(piece,faces.size());
+        for (size_t i=0;i<verts.size();i++)
+            piece.vert[i].ImportData(ref.mesh.vert[verts[i]]);
+        for (size_t i=0;i<faces.size();i++)
+        {
+            piece.face[i].ImportData(*faces[i]);
+            for (int j=0;j<3;j++)
+                piece.face[i].V(j)=&piece.vert[refToPiece[vcg::tri::Index(ref.mesh,faces[i]->V(j))]];
+        }
+        for (size_t i=0;i<verts.size();i++)
+            refToPiece[verts[i]]=-1;
+        vcg::tri::UpdateBounding<Mesh>::Box(piece);
+    }
+
+    static void ProjectAndRemesh(Mesh & m, Mesh & toProject, RemeshParams & para)
+    {
+        vcg::tri::UpdateBounding<Mesh>::Box(m);
+        vcg::tri::UpdateNormal<Mesh>::PerVertexNormalizedPerFaceNormalized(m);
+        vcg::tri::IsotropicRemeshing<Mesh>::Do(m, toProject, para);
+    }
+
+    //global vertex index + 1 of the tile vertices copied from the mesh, 0 for new ones
+    static typename Mesh::template PerVertexAttributeHandle<size_t> TileGlobalIndex(Mesh & tile)
+    {
+        return vcg::tri::Allocator<Mesh>::template GetPerVertexAttribute<size_t>(tile, std::string("RemeshTileGlobalIndex"));
+    }
+
+    //faces grouped by the grid cell of their barycenter
+    static std::vector<std::vector<size_t> > PartitionFaces(Mesh & m, const ScalarType cell, const CoordType & offset)
+    {
+        std::map<vcg::Point3i, size_t> cellTile;
+        std::vector<std::vector<size_t> > tiles;
+        for (size_t i=0;i<m.face.size();i++)
+        {
+            if (m.face[i].IsD())continue;
+            CoordType bary=(m.face[i].cP(0)+m.face[i].cP(1)+m.face[i].cP(2))/3-m.bbox.min+offset;
+            vcg::Point3i c((int)std::floor(bary.X()/cell),
+                           (int)std::floor(bary.Y()/cell),
+                           (int)std::floor(bary.Z()/cell));
+            auto it=cellTile.find(c);
+            if (it==cellTile.end())
+            {
+                it=cellTile.insert(std::make_pair(c,tiles.size())).first;
+                tiles.push_back(std::vector<size_t>());
+            }
+            tiles[it->second].push_back(i);
+        }
+        return tiles;
+    }
+
+    //border edges of the tile between cut vertices, as pairs of global indices
+    static std::set<std::pair<size_t,size_t> > CutBorder(Mesh & tile, const std::vector<bool> & cut)
+    {
+        auto globalIndex=TileGlobalIndex(tile);
+        std::set<std::pair<size_t,size_t> > border;
+        for (size_t i=0;i<tile.face.size();i++)
+        {
+            if (tile.face[i].IsD())continue;
+            for (int j=0;j<3;j++)
+            {
+                if (!vcg::face::IsBorder(tile.face[i],j))continue;
+                size_t g0=globalIndex[tile.face[i].V0(j)];
+                size_t g1=globalIndex[tile.face[i].V1(j)];
+                if ((g0==0)||(g1==0))continue;
+                if ((!cut[g0-1])&&(!cut[g1-1]))continue;
+                border.insert(std::make_pair(std::min(g0,g1),std::max(g0,g1)));
+            }
+        }
+        return border;
+    }
+
+    //selects the faces of the tile farther than two rings from the cut vertices
+    static void LockCutBand(Mesh & tile, const std::vector<bool> & cut)
+    {
+        auto globalIndex=TileGlobalIndex(tile);
+        std::vector<bool> locked(tile.vert.size(),false);
+        for (size_t i=0;i<tile.vert.size();i++)
+            locked[i]=(globalIndex[i]>0)&&cut[globalIndex[i]-1];
+
+        for (size_t i=0;i<tile.face.size();i++)
+            tile.face[i].SetS();
+        for (int ring=0;ring<2;ring++)
+        {
+            std::vector<bool> lockedNext=locked;
+            for (size_t i=0;i<tile.face.size();i++)
+            {
+                FaceType & f=tile.face[i];
+                if (!(locked[vcg::tri::Index(tile,f.V(0))]||
+                      locked[vcg::tri::Index(tile,f.V(1))]||
+                      locked[vcg::tri::Index(tile,f.V(2))]))continue;
+                f.ClearS();
+                for (int j=0;j<3;j++)
+                    lockedNext[vcg::tri::Index(tile,f.V(j))]=true;
+            }
+            locked.swap(lockedNext);
+        }
+    }
+
+    //copy of the faces of the tile, see LockCutBand
+    static void ExtractTile(Mesh & m,
+                            const std::vector<size_t> & faces,
+                            const std::vector<bool> & cut,
+                            std::vector<int> & globalToTile,
+                            Mesh & tile)
+    {
+        std::vector<size_t> verts;
+        for (size_t i=0;i<faces.size();i++)
+            for (int j=0;j<3;j++)
+            {
+                size_t vi=vcg::tri::Index(m,m.face[faces[i]].V(j));
+                if (globalToTile[vi]>=0)continue;
+                globalToTile[vi]=verts.size();
+                verts.push_back(vi);
+            }
+
+        vcg::tri::Allocator<Mesh>::AddVertices(tile,verts.size());
+        vcg::tri::Allocator<Mesh>::AddFaces(tile,faces.size());
+        auto globalIndex=TileGlobalIndex(tile);
+        for (size_t i=0;i<verts.size();i++)
+        {
+            tile.vert[i].ImportData(m.vert[verts[i]]);
+            globalIndex[i]=verts[i]+1;
+        }
+        for (size_t i=0;i<faces.size();i++)
+        {
+            tile.face[i].ImportData(m.face[faces[i]]);
+            for (int j=0;j<3;j++)
+                tile.face[i].V(j)=&tile.vert[globalToTile[vcg::tri::Index(m,m.face[faces[i]].V(j))]];
+        }
+        for (size_t i=0;i<verts.size();i++)
+            globalToTile[verts[i]]=-1;
+
+        LockCutBand(tile,cut);
+
+        vcg::tri::UpdateBounding<Mesh>::Box(tile);
+        vcg::tri::UpdateTopology<Mesh>::FaceFace(tile);
+    }
+
+    //replaces the faces of each remeshed tile, the cut vertices are shared with the neighbour tiles
+    static void MergeTiles(Mesh & m,
+                           const std::vector<std::vector<size_t> > & tiles,
+                           const std::vector<std::shared_ptr<Mesh> > & remeshed,
+                           const std::vector<bool> & cut)
+    {
+        size_t addV=0,addF=0;
+        for (size_t t=0;t<tiles.size();t++)
+        {
+            if (!remeshed[t])continue;
+            Mesh & tile=*remeshed[t];
+            auto globalIndex=TileGlobalIndex(tile);
+            for (size_t i=0;i<tile.vert.size();i++)
+                if ((globalIndex[i]==0)||(!cut[globalIndex[i]-1]))addV++;
+            addF+=tile.face.size();
+
+            for (size_t i=0;i<tiles[t].size();i++)
+            {
+                FaceType & f=m.face[tiles[t][i]];
+                for (int j=0;j<3;j++)
+                    if ((!cut[vcg::tri::Index(m,f.V(j))])&&(!f.V(j)->IsD()))
+                        vcg::tri::Allocator<Mesh>::DeleteVertex(m,*f.V(j));
+                vcg::tri::Allocator<Mesh>::DeleteFace(m,f);
+            }
+        }
+
+        size_t nextV=m.vert.size();
+        size_t nextF=m.face.size();
+        vcg::tri::Allocator<Mesh>::AddVertices(m,addV);
+        vcg::tri::Allocator<Mesh>::AddFaces(m,addF);
+        for (size_t t=0;t<tiles.size();t++)
+        {
+            if (!remeshed[t])continue;
+            Mesh & tile=*remeshed[t];
+            auto globalIndex=TileGlobalIndex(tile);
+            std::vector<size_t> target(tile.vert.size());
+            for (size_t i=0;i<tile.vert.size();i++)
+            {
+                if ((globalIndex[i]>0)&&(cut[globalIndex[i]-1]))
+                {
+                    target[i]=globalIndex[i]-1;
+                    continue;
+                }
+                target[i]=nextV++;
+                m.vert[target[i]].ImportData(tile.vert[i]);
+                m.vert[target[i]].ClearS();
+            }
+            for (size_t i=0;i<tile.face.size();i++)
+            {
+                FaceType & f=m.face[nextF++];
+                f.ImportData(tile.face[i]);
+                f.ClearS();
+                for (int j=0;j<3;j++)
+                    f.V(j)=&m.vert[target[vcg::tri::Index(tile,tile.face[i].V(j))]];
+            }
+        }
+        assert(nextV==m.vert.size());
+        assert(nextF==m.face.size());
+
+        vcg::tri::Allocator<Mesh>::CompactEveryVector(m);
+        vcg::tri::UpdateTopology<Mesh>::FaceFace(m);
+        vcg::tri::UpdateBounding<Mesh>::Box(m);
+    }
+
+    //IsotropicRemeshing on spatial tiles, on numThreads threads (one after the other with a single
+    //thread, which still bounds the cost of the distance check). The vertices on the cuts between
+    //tiles and two rings of faces around them are locked, the tiles are shifted between rounds so
+    //that the locked bands get remeshed too. A tile whose border changed anyway keeps its faces.
+    //Each tile projects on (and checks the distance to) the piece of ref around it, so the surface
+    //distance check stays cheap however big the mesh is.
+    static void ParallelRemesh(Mesh & m, RemeshParams & para, const int numThreads, Reference & ref)
+    {
+        const int rounds=3;
+        const int maxTileFN=100000;
+        const size_t nThreads=QuadRetopology::internal::numWorkerThreads(numThreads,std::numeric_limits<size_t>::max());
+        //a few tiles per thread for load balancing, and small enough for the distance check
+        const size_t numTiles=std::max(4*nThreads,(size_t)(m.FN()+maxTileFN-1)/maxTileFN);
+        const ScalarType cell=std::sqrt(vcg::tri::Stat<Mesh>::ComputeMeshArea(m)/numTiles);
+
+        RemeshParams tilePara=para;
+        tilePara.iter=std::max(1,(para.iter+rounds-1)/rounds);
+        tilePara.selectedOnly=true;
+
+        for (int r=0;r<rounds;r++)
+        {
+            vcg::tri::UpdateBounding<Mesh>::Box(m);
+            const CoordType offset=CoordType(1,1,1)*(cell*r/rounds);
+            const std::vector<std::vector<size_t> > tiles=PartitionFaces(m,cell,offset);
+
+            std::vector<int> vertTile(m.vert.size(),-1);
+            std::vector<bool> cut(m.vert.size(),false);
+            for (size_t t=0;t<tiles.size();t++)
+                for (size_t i=0;i<tiles[t].size();i++)
+                    for (int j=0;j<3;j++)
+                    {
+                        size_t vi=vcg::tri::Index(m,m.face[tiles[t][i]].V(j));
+                        if (vertTile[vi]<0)
+                            vertTile[vi]=t;
+                        else if (vertTile[vi]!=(int)t)
+                            cut[vi]=true;
+                    }
+
+            std::vector<std::shared_ptr<Mesh> > remeshed(tiles.size());
+            std::vector<std::shared_ptr<Mesh> > toProject(tiles.size());
+            std::vector<int> globalToTile(m.vert.size(),-1);
+            std::vector<int> refToPiece(ref.mesh.vert.size(),-1);
+            for (size_t t=0;t<tiles.size();t++)
+            {
+                remeshed[t]=std::make_shared<Mesh>();
+                ExtractTile(m,tiles[t],cut,globalToTile,*remeshed[t]);
+                //room for the vertices to slide past the tile while smoothing
+                vcg::Box3<ScalarType> box=remeshed[t]->bbox;
+                box.Offset(std::max(box.Diag()*(ScalarType)0.1,2*para.maxLength));
+                toProject[t]=std::make_shared<Mesh>();
+                ExtractReference(ref,box,refToPiece,*toProject[t]);
+            }
+
+            std::vector<char> failed(tiles.size(),0);
+            QuadRetopology::internal::parallelFor(tiles.size(),numThreads,[&](const size_t t)
+            {
+                Mesh & tile=*remeshed[t];
+                const std::set<std::pair<size_t,size_t> > border=CutBorder(tile,cut);
+                RemeshParams para_t=tilePara;
+                ProjectAndRemesh(tile,*toProject[t],para_t);
+                toProject[t].reset();
+                vcg::tri::Allocator<Mesh>::CompactEveryVector(tile);
+                vcg::tri::UpdateTopology<Mesh>::FaceFace(tile);
+                if (CutBorder(tile,cut)!=border)
+                {
+                    failed[t]=1;
+                    remeshed[t].reset();
+                }
+            });
+
+            std::cout << "Parallel remeshing round " << r << ": " << tiles.size() << " tiles, "
+                      << std::count(failed.begin(),failed.end(),1) << " rejected" << std::endl;
+            MergeTiles(m,tiles,remeshed,cut);
+        }
+    }
+
+    static void Remesh(Mesh & m, RemeshParams & para, const int numThreads, Reference & ref)
+    {
+        //tiles must be large compared to the locked bands
+        const int minParallelFN=100000;
+        //above this size the distance check on the whole mesh is too slow
+        const int maxSurfDistCheckFN=400000;
+        if ((!para.selectedOnly)&&
+                (((numThreads!=1)&&(m.FN()>minParallelFN))||
+                 (para.surfDistCheck&&(m.FN()>=maxSurfDistCheckFN))))
+            ParallelRemesh(m,para,numThreads,ref);
+        else
+            ProjectAndRemesh(m,ref.mesh,para);
+    }
+
+    //RemeshAdapt on a tile whose vertices carry TileGlobalIndex, the vertices marked in cut
+    //(by global index) are shared with other tiles and stay as they are together with their
+    //border edges. Returns false if the border changed anyway, the tile is then unusable.
+    static bool RemeshTile(Mesh & tile, Params & par, const std::vector<bool> & cut)
+    {
+        vcg::tri::UpdateTopology<Mesh>::FaceFace(tile);
+        LockCutBand(tile,cut);
+        const std::set<std::pair<size_t,size_t> > border=CutBorder(tile,cut);
+
+        Params tilePar=par;
+        tilePar.selectedOnly=true;
+        tilePar.numThreads=1;
+        RemeshAdapt(tile,tilePar);
+
+        vcg::tri::Allocator<Mesh>::CompactEveryVector(tile);
+        vcg::tri::UpdateTopology<Mesh>::FaceFace(tile);
+        return (CutBorder(tile,cut)==border);
+    }
+
+    //big meshes are remeshed on tiles (see Remesh) to keep par.surfDistCheck affordable
     //static std::shared_ptr<Mesh> Remesh (Mesh & m, Params & par)
     static void RemeshAdapt(Mesh & m, Params & par)
     {
@@ -373,7 +930,7 @@ public:
         para.collapseFlag = true;
         para.smoothFlag   = true;
         para.projectFlag  = true;
-        para.selectedOnly = false;
+        para.selectedOnly = par.selectedOnly;
         para.adapt=false;
         para.aspectRatioThr = 0.3;
         para.cleanFlag = true;
@@ -381,8 +938,10 @@ public:
         para.minAdaptiveMult = par.minAdaptiveMult;
         para.maxAdaptiveMult = par.maxAdaptiveMult;
 
-        para.maxSurfDist = m.bbox.Diag() / 2500.;
-        para.surfDistCheck = m.FN() < 400000 ? par.surfDistCheck : false;
+        if (par.maxSurfDist == 0)
+            par.maxSurfDist = m.bbox.Diag() / 2500.;
+        para.maxSurfDist = par.maxSurfDist;
+        para.surfDistCheck = par.surfDistCheck;
         para.userSelectedCreases = true;
 
 
@@ -395,9 +954,13 @@ public:
         para.SetTargetLen(par.targetEdgeLen);
 
 
-        std::cout << "Before Remeshing - faces: " << m.FN() << " quality: " <<  computeAR(m) << std::endl;
-        vcg::tri::IsotropicRemeshing<Mesh>::Do(m, para);
-        std::cout << "After Iter 0 - faces: " << m.FN() << " quality: " <<  computeAR(m) << std::endl;
+        //both passes project on the input surface
+        Reference ref;
+        InitReference(m, ref);
+
+        std::cout << "Before Remeshing - faces: " << m.FN() << " quality: " <<  computeAR(m, 0.05, par.numThreads) << std::endl;
+        Remesh(m, para, par.numThreads, ref);
+        std::cout << "After Iter 0 - faces: " << m.FN() << " quality: " <<  computeAR(m, 0.05, par.numThreads) << std::endl;
 
 
         const ScalarType thr = 0.01;
@@ -409,13 +972,12 @@ public:
 
         para.adapt = true;
         para.smoothFlag   = true;
-        para.maxSurfDist = m.bbox.Diag() / 2500.;
 
-        vcg::tri::IsotropicRemeshing<Mesh>::Do(m, para);
+        Remesh(m, para, par.numThreads, ref);
 
         m.UpdateDataStructures();
 
-        std::cout << "After Iter 1 - faces: " << m.FN() << " quality: " <<  computeAR(m) << std::endl;
+        std::cout << "After Iter 1 - faces: " << m.FN() << " quality: " <<  computeAR(m, 0.05, par.numThreads) << std::endl;
 
 //        MakeEdgeSelConsistent(m);
 //        SelectAllBoundaryV(m);
@@ -429,56 +991,98 @@ public:
     }
 
 
-    //    static int SelectToRemesh(Mesh & m,ScalarType minR=0.2,size_t dilate=3)
-    //    {
-    //        vcg::tri::UpdateSelection<Mesh>::FaceClear(m);
-    //        for (size_t i=0;i<m.face.size();i++)
-    //        {
-    //            m.face[i].Q() = vcg::QualityRadii(m.face[i].cP(0),
-    //                                              m.face[i].cP(1),
-    //                                              m.face[i].cP(2));
-    //            if (m.face[i].Q()<minR)
-    //                m.face[i].SetS();
-    //       }
-    ////        //then check the borders
-    ////        vcg::tri::UpdateSelection<Mesh>::VertexClear(m);
-    ////        for (size_t i=0;i<m.face.size();i++)
-    ////            for (size_t j=0;j<3;j++)
-    ////            {
-    ////                if (!m.face[i].IsFaceEdgeS(j))continue;
-    ////                m.face[i].V0(j)->SetS();
-    ////                m.face[i].V1(j)->SetS();
-    ////            }
-    ////        for (size_t i=0;i<m.face.size();i++)
-    ////            for (size_t j=0;j<3;j++)
-    ////            {
-    ////                if (m.face[i].IsFaceEdgeS(j))continue;
-    ////                if (!m.face[i].V0(j)->IsS())continue;
-    ////                if (!m.face[i].V1(j)->IsS())continue;
-    ////                m.face[i].SetS();
-    ////            }
-
-    //        vcg::tri::UpdateSelection<Mesh>::VertexClear(m);
-    //        for (size_t s=0;s<dilate;s++)
-    //        {
-    //            vcg::tri::UpdateSelection<Mesh>::VertexFromFaceLoose(m);
-    //            vcg::tri::UpdateSelection<Mesh>::FaceFromVertexLoose(m);
-    //        }
+    //selects the faces with QualityRadii below minR, grown by dilate rings
+    static int SelectToRemesh(Mesh & m,ScalarType minR=0.2,size_t dilate=3,int numThreads=1)
+    {
+        vcg::tri::UpdateSelection<Mesh>::FaceClear(m);
+        UpdateQualityRadii(m,numThreads);
+        for (size_t i=0;i<m.face.size();i++)
+        {
+            if (m.face[i].IsD())continue;
+            if (m.face[i].Q()<minR)
+                m.face[i].SetS();
+        }
 
-    //        int numS=0;
-    //        for (size_t i=0;i<m.face.size();i++)
-    //            if (m.face[i].IsS())numS++;
-    //        return (numS);
-    //    }
+        vcg::tri::UpdateSelection<Mesh>::VertexClear(m);
+        for (size_t s=0;s<dilate;s++)
+        {
+            vcg::tri::UpdateSelection<Mesh>::VertexFromFaceLoose(m);
+            vcg::tri::UpdateSelection<Mesh>::FaceFromVertexLoose(m);
+        }
+
+        int numS=0;
+        for (size_t i=0;i<m.face.size();i++)
+            if ((!m.face[i].IsD())&&(m.face[i].IsS()))numS++;
+        return (numS);
+    }
+
+    //remeshes only the region selected by SelectToRemesh, the rest of the mesh is kept as it is
+    //and the border of the region is locked (see RemeshTile), so the cost follows the size of the
+    //region. Falls back to RemeshAdapt when the region covers most of the mesh.
+    static void RemeshSelective(Mesh & m, Params & par, const ScalarType minR=0.2, const size_t dilate=3)
+    {
+        vcg::tri::UpdateBounding<Mesh>::Box(m);
+        vcg::tri::UpdateTopology<Mesh>::FaceFace(m);
+
+        //two more rings for the band locked along the border of the region
+        const int numSel=SelectToRemesh(m,minR,dilate+2,par.numThreads);
+        std::cout << "Selective remeshing - faces: " << numSel << " of " << m.FN() << std::endl;
+        if (numSel==0)return;
+        if (numSel>m.FN()/2)
+        {
+            vcg::tri::UpdateSelection<Mesh>::Clear(m);
+            RemeshAdapt(m,par);
+            return;
+        }
+
+        //same resolution and tolerance as the full remeshing
+        if (par.targetEdgeLen == 0)
+            par.targetEdgeLen = ExpectedEdgeL(m);
+        if (par.maxSurfDist == 0)
+            par.maxSurfDist = m.bbox.Diag() / 2500.;
+
+        std::vector<std::vector<size_t> > region(1);
+        std::vector<bool> inRegion(m.vert.size(),false);
+        std::vector<bool> outRegion(m.vert.size(),false);
+        for (size_t i=0;i<m.face.size();i++)
+        {
+            if (m.face[i].IsD())continue;
+            if (m.face[i].IsS())
+                region[0].push_back(i);
+            for (int j=0;j<3;j++)
+            {
+                size_t vi=vcg::tri::Index(m,m.face[i].V(j));
+                if (m.face[i].IsS())
+                    inRegion[vi]=true;
+                else
+                    outRegion[vi]=true;
+            }
+        }
+        std::vector<bool> cut(m.vert.size(),false);
+        for (size_t i=0;i<m.vert.size();i++)
+            cut[i]=inRegion[i]&&outRegion[i];
+
+        std::vector<std::shared_ptr<Mesh> > remeshed(1,std::make_shared<Mesh>());
+        std::vector<int> globalToTile(m.vert.size(),-1);
+        ExtractTile(m,region[0],cut,globalToTile,*remeshed[0]);
+        vcg::tri::UpdateSelection<Mesh>::Clear(m);
+        if (!RemeshTile(*remeshed[0],par,cut))
+        {
+            std::cout << "WARNING: the border of the region changed, keeping it as it is" << std::endl;
+            return;
+        }
+        MergeTiles(m,region,remeshed,cut);
+        m.UpdateDataStructures();
+        std::cout << "After Selective Remeshing - faces: " << m.FN() << " quality: " <<  computeAR(m, 0.05, par.numThreads) << std::endl;
+    }
 
-    static int NumBadTris(Mesh & m,ScalarType minR=0.2,size_t dilate=3)
+    static int NumBadTris(Mesh & m,ScalarType minR=0.2,size_t dilate=3,int numThreads=1)
     {
         int numS=0;
+        UpdateQualityRadii(m,numThreads);
         for (size_t i=0;i<m.face.size();i++)
         {
-            m.face[i].Q() = vcg::QualityRadii(m.face[i].cP(0),
-                                              m.face[i].cP(1),
-                                              m.face[i].cP(2));
+            if (m.face[i].IsD())continue;
             if (m.face[i].Q()<minR)
                 numS++;
         }
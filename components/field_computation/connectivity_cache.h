@@ -0,0 +1,117 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef CONNECTIVITY_CACHE_H
+#define CONNECTIVITY_CACHE_H
+
+#include <vcg/complex/complex.h>
+
+namespace vcg {
+namespace tri {
+
+//Data derived from the connectivity of a mesh (adjacency, index arrays), kept in a
+//per mesh attribute and rebuilt only when the faces changed: the element counts or
+//the FNV-1a hash of the face vertex indices differ from the ones it was built for.
+//The counts are compared first, the hash is only taken when they match, to catch
+//the edits that keep them (e.g. edge flips).
+template <class MeshType>
+class ConnectivityCache
+{
+    template <class DataType>
+    struct Entry
+    {
+        size_t vertSize=0;
+        size_t faceSize=0;
+        size_t vn=0;
+        size_t fn=0;
+        size_t fingerprint=0;
+        bool built=false;
+        DataType data;
+    };
+
+public:
+
+    static size_t Fingerprint(MeshType &mesh)
+    {
+        //FNV-1a over the face vertex indices
+        size_t h=14695981039346656037ULL;
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (mesh.face[i].IsD())continue;
+            for (int j=0;j<3;j++)
+            {
+                h^=(size_t)vcg::tri::Index(mesh,mesh.face[i].cV(j));
+                h*=1099511628211ULL;
+            }
+        }
+        return h;
+    }
+
+    //the data stored under name, build(mesh,data) is called first if the mesh changed
+    //or if usable(data) is false (e.g. it lacks something the caller needs now)
+    template <class DataType,class Build,class Usable>
+    static const DataType &Get(MeshType &mesh,const char *name,Build build,Usable usable)
+    {
+        typename MeshType::template PerMeshAttributeHandle<Entry<DataType> > EH=
+                vcg::tri::Allocator<MeshType>::template GetPerMeshAttribute<Entry<DataType> >(mesh,name);
+        Entry<DataType> &E=EH();
+        bool valid=(E.built)&&
+                (E.vertSize==mesh.vert.size())&&
+                (E.faceSize==mesh.face.size())&&
+                (E.vn==(size_t)mesh.vn)&&
+                (E.fn==(size_t)mesh.fn)&&
+                (usable(E.data));
+        //the hash is a full pass on the faces, only when the cheap checks passed
+        size_t fingerprint=0;
+        bool hashed=false;
+        if (valid)
+        {
+            fingerprint=Fingerprint(mesh);
+            hashed=true;
+            valid=(E.fingerprint==fingerprint);
+        }
+        if (!valid)
+        {
+            build(mesh,E.data);
+            E.vertSize=mesh.vert.size();
+            E.faceSize=mesh.face.size();
+            E.vn=mesh.vn;
+            E.fn=mesh.fn;
+            E.fingerprint=(hashed)?fingerprint:Fingerprint(mesh);
+            E.built=true;
+        }
+        return E.data;
+    }
+
+    template <class DataType,class Build>
+    static const DataType &Get(MeshType &mesh,const char *name,Build build)
+    {
+        return Get<DataType>(mesh,name,build,[](const DataType &){return true;});
+    }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // CONNECTIVITY_CACHE_H
@@ -0,0 +1,252 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef FACE_GEOMETRY_H
+#define FACE_GEOMETRY_H
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include <Eigen/Core>
+
+#include <vcg/complex/complex.h>
+
+#include <quadretopology/includes/qr_parallel.h>
+
+#include "connectivity_cache.h"
+
+namespace vcg {
+namespace tri {
+
+//Structure of arrays copy of the face corners, for the per face measures that the cleaning
+//and remeshing passes evaluate over and over (radii ratio, area, normals, dihedral angles).
+//The face indices and adjacency are kept in a ConnectivityCache, the positions are gathered
+//again at each Update. The kernels work on Eigen arrays, so they are vectorized on SSE/AVX and
+//NEON alike, in parallel over blocks of faces.
+//Deleted faces get zero positions, consumers skip them as usual.
+template <class MeshType>
+class FaceGeometry
+{
+    typedef typename MeshType::FaceType FaceType;
+    typedef typename MeshType::ScalarType ScalarType;
+    typedef typename MeshType::CoordType CoordType;
+
+public:
+
+    typedef Eigen::Array<ScalarType,Eigen::Dynamic,1> ArrayX;
+
+    struct Topology
+    {
+        //vertex j of face i, -1 for deleted faces
+        std::vector<int> FV[3];
+        //face across edge j of face i, -1 on borders, only filled with the adjacency
+        std::vector<int> FF[3];
+        bool hasFF=false;
+    };
+
+    struct Snapshot
+    {
+        const Topology *T=nullptr;
+        //coordinates of corner j of each face
+        ArrayX X[3];
+        ArrayX Y[3];
+        ArrayX Z[3];
+
+        size_t size()const{return X[0].size();}
+    };
+
+private:
+
+    static const size_t BlockSize=4096;
+
+    static void BuildTopology(MeshType &mesh,Topology &T,bool withFF)
+    {
+        const size_t nF=mesh.face.size();
+        for (int j=0;j<3;j++)
+        {
+            T.FV[j].assign(nF,-1);
+            T.FF[j].assign(withFF?nF:0,-1);
+        }
+        for (size_t i=0;i<nF;i++)
+        {
+            const FaceType &f=mesh.face[i];
+            if (f.IsD())continue;
+            for (int j=0;j<3;j++)
+            {
+                T.FV[j][i]=vcg::tri::Index(mesh,f.cV(j));
+                if ((withFF)&&(!vcg::face::IsBorder(f,j)))
+                    T.FF[j][i]=vcg::tri::Index(mesh,f.cFFp(j));
+            }
+        }
+        T.hasFF=withFF;
+    }
+
+    static const Topology &GetTopology(MeshType &mesh,bool withFF)
+    {
+        return ConnectivityCache<MeshType>::template Get<Topology>(mesh,"FaceGeometryTopology",
+                [withFF](MeshType &m,Topology &T){BuildTopology(m,T,withFF);},
+                [withFF](const Topology &T){return (!withFF)||(T.hasFF);});
+    }
+
+    //calls f(begin,size) on blocks of faces
+    template <class F>
+    static void ForBlocks(size_t n,int numThreads,F f)
+    {
+        const size_t nBlocks=(n+BlockSize-1)/BlockSize;
+        QuadRetopology::internal::parallelFor(nBlocks,numThreads,[&](const size_t block)
+        {
+            const size_t begin=block*BlockSize;
+            f(begin,std::min(n,begin+BlockSize)-begin);
+        });
+    }
+
+public:
+
+    //refreshes the positions, and the indices if the faces changed. withFF also stores the
+    //face adjacency for NormalDots, the FF topology of the mesh must be up to date then
+    static void Update(MeshType &mesh,Snapshot &S,int numThreads=1,bool withFF=false)
+    {
+        const Topology &T=GetTopology(mesh,withFF);
+        S.T=&T;
+        const size_t nF=mesh.face.size();
+        for (int j=0;j<3;j++)
+        {
+            S.X[j].resize(nF);
+            S.Y[j].resize(nF);
+            S.Z[j].resize(nF);
+        }
+        ForBlocks(nF,numThreads,[&](const size_t begin,const size_t size)
+        {
+            for (int j=0;j<3;j++)
+                for (size_t i=begin;i<begin+size;i++)
+                {
+                    const int v=T.FV[j][i];
+                    const CoordType P=(v<0)?CoordType(0,0,0):mesh.vert[v].cP();
+                    S.X[j][i]=P.X();
+                    S.Y[j][i]=P.Y();
+                    S.Z[j][i]=P.Z();
+                }
+        });
+    }
+
+    //same as vcg::QualityRadii, 0 for degenerate faces
+    static void QualityRadii(const Snapshot &S,ArrayX &Q,int numThreads=1)
+    {
+        Q.resize(S.size());
+        ForBlocks(S.size(),numThreads,[&](const size_t b,const size_t n)
+        {
+            const ArrayX dx01=S.X[1].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX dy01=S.Y[1].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX dz01=S.Z[1].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX dx02=S.X[2].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX dy02=S.Y[2].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX dz02=S.Z[2].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX dx21=S.X[1].segment(b,n)-S.X[2].segment(b,n);
+            const ArrayX dy21=S.Y[1].segment(b,n)-S.Y[2].segment(b,n);
+            const ArrayX dz21=S.Z[1].segment(b,n)-S.Z[2].segment(b,n);
+            const ArrayX la=(dx01*dx01+dy01*dy01+dz01*dz01).sqrt();
+            const ArrayX lb=(dx02*dx02+dy02*dy02+dz02*dz02).sqrt();
+            const ArrayX lc=(dx21*dx21+dy21*dy21+dz21*dz21).sqrt();
+            const ArrayX sum=(la+lb+lc)*ScalarType(0.5);
+            const ArrayX area2=sum*(la+lb-sum)*(la+lc-sum)*(lb+lc-sum);
+            Q.segment(b,n)=(area2>ScalarType(0)).select((ScalarType(8)*area2)/(la*lb*lc*sum),ScalarType(0));
+        });
+    }
+
+    //same as vcg::DoubleArea
+    static void DoubleArea(const Snapshot &S,ArrayX &A,int numThreads=1)
+    {
+        A.resize(S.size());
+        ForBlocks(S.size(),numThreads,[&](const size_t b,const size_t n)
+        {
+            const ArrayX ex=S.X[1].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX ey=S.Y[1].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX ez=S.Z[1].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX fx=S.X[2].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX fy=S.Y[2].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX fz=S.Z[2].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX nx=ey*fz-ez*fy;
+            const ArrayX ny=ez*fx-ex*fz;
+            const ArrayX nz=ex*fy-ey*fx;
+            A.segment(b,n)=(nx*nx+ny*ny+nz*nz).sqrt();
+        });
+    }
+
+    //unit normals from the positions as vcg::TriangleNormal(f).Normalize(), zero for degenerate faces
+    static void Normals(const Snapshot &S,ArrayX N[3],int numThreads=1)
+    {
+        for (int j=0;j<3;j++)
+            N[j].resize(S.size());
+        ForBlocks(S.size(),numThreads,[&](const size_t b,const size_t n)
+        {
+            const ArrayX ex=S.X[1].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX ey=S.Y[1].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX ez=S.Z[1].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX fx=S.X[2].segment(b,n)-S.X[0].segment(b,n);
+            const ArrayX fy=S.Y[2].segment(b,n)-S.Y[0].segment(b,n);
+            const ArrayX fz=S.Z[2].segment(b,n)-S.Z[0].segment(b,n);
+            const ArrayX nx=ey*fz-ez*fy;
+            const ArrayX ny=ez*fx-ex*fz;
+            const ArrayX nz=ex*fy-ey*fx;
+            const ArrayX len=(nx*nx+ny*ny+nz*nz).sqrt();
+            N[0].segment(b,n)=(len>ScalarType(0)).select(nx/len,ScalarType(0));
+            N[1].segment(b,n)=(len>ScalarType(0)).select(ny/len,ScalarType(0));
+            N[2].segment(b,n)=(len>ScalarType(0)).select(nz/len,ScalarType(0));
+        });
+    }
+
+    //D[j][i] is the dot product of the unit normals of face i and of the face across its edge j,
+    //the cosine of the dihedral angle used by vcg::face::DihedralAngleRad; 2 on borders.
+    //Needs a snapshot updated withFF
+    static void NormalDots(const Snapshot &S,const ArrayX N[3],ArrayX D[3],int numThreads=1)
+    {
+        assert(S.T->hasFF);
+        for (int j=0;j<3;j++)
+            D[j].resize(S.size());
+        ForBlocks(S.size(),numThreads,[&](const size_t b,const size_t n)
+        {
+            ArrayX ox(n),oy(n),oz(n);
+            for (int j=0;j<3;j++)
+            {
+                const std::vector<int> &FF=S.T->FF[j];
+                for (size_t i=0;i<n;i++)
+                {
+                    const int f=FF[b+i];
+                    ox[i]=(f<0)?ScalarType(0):N[0][f];
+                    oy[i]=(f<0)?ScalarType(0):N[1][f];
+                    oz[i]=(f<0)?ScalarType(0):N[2][f];
+                }
+                const ArrayX dot=N[0].segment(b,n)*ox+N[1].segment(b,n)*oy+N[2].segment(b,n)*oz;
+                for (size_t i=0;i<n;i++)
+                    D[j][b+i]=(FF[b+i]<0)?ScalarType(2):std::max(ScalarType(-1),std::min(ScalarType(1),dot[i]));
+            }
+        });
+    }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // FACE_GEOMETRY_H
@@ -32,11 +32,16 @@
 #include <vcg/complex/algorithms/update/quality.h>
 #include <vcg/complex/algorithms/parametrization/tangent_field_operators.h>
 #include <vcg/complex/algorithms/mesh_to_matrix.h>
+#include <vcg/complex/algorithms/clustering.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <vcg/complex/algorithms/stat.h>
+#include <vcg/complex/algorithms/closest.h>
+#include <vcg/space/index/grid_static_ptr.h>
 
 //igl related stuff
 
 #include "fields/n_polyvector.h"
-#include <igl/principal_curvature.h>
+#include "fields/principal_curvature.h"
 #include <igl/igl_inline.h>
 
 #ifdef COMISO_FIELD
@@ -364,6 +369,13 @@ public:
         std::vector<std::pair<int,CoordType> > AddConstr;
         //the number of iteration in case of iterative method
         size_t IteN;
+        //if the mesh has more faces, MIQ/NPoly is solved on a clustered proxy of about this many faces
+        //and prolongated to the mesh (0, always solve on the full mesh)
+        size_t hierarchy_faces;
+        //local smoothing sweeps on the full mesh after the prolongation
+        size_t hierarchy_sweeps;
+        //threads for the curvature estimation (0, one per hardware thread)
+        int num_threads;
 
         SmoothParam()
         {
@@ -375,34 +387,19 @@ public:
             sharp_thr=0.0;
             curv_thr=0.4;
             IteN=20;
+            hierarchy_faces=0;
+            hierarchy_sweeps=10;
+            num_threads=1;
         }
 
     };
 
     static void InitByCurvature(MeshType & mesh,
                                 unsigned Nring,
-                                bool UpdateFaces=true)
+                                bool UpdateFaces=true,
+                                int numThreads=1)
     {
-
-        tri::RequirePerVertexCurvatureDir(mesh);
-
-        Eigen::MatrixXi F;
-        typename vcg::tri::MeshToMatrix<MeshType>::MatrixXm Vf;
-
-        Eigen::MatrixXd PD1,PD2,PV1,PV2;
-        MeshToMatrix<MeshType>::GetTriMeshData(mesh,F,Vf);
-        Eigen::MatrixXd V = Vf.template cast<double>();
-
-        igl::principal_curvature(V,F,PD1,PD2,PV1,PV2,Nring,true);
-
-        //then copy curvature per vertex
-        for (size_t i=0;i<mesh.vert.size();i++)
-        {
-            mesh.vert[i].PD1()=CoordType(PD1(i,0),PD1(i,1),PD1(i,2));
-            mesh.vert[i].PD2()=CoordType(PD2(i,0),PD2(i,1),PD2(i,2));
-            mesh.vert[i].K1()=PV1(i,0);
-            mesh.vert[i].K2()=PV2(i,0);
-        }
+        vcg::tri::PrincipalCurvature<MeshType>::Compute(mesh,Nring,numThreads);
         if (!UpdateFaces)return;
         vcg::tri::CrossField<MeshType>::SetFaceCrossVectorFromVert(mesh);
         InitQualityByAnisotropyDir(mesh);
@@ -509,6 +506,208 @@ private:
         }
     }
 
+    //vertex clustering on a grid of cells of the given edge length
+    static void ClusterMesh(MeshType &mesh,ScalarType cellSize,MeshType &proxy)
+    {
+        proxy.Clear();
+        vcg::tri::Clustering<MeshType,vcg::tri::NearestToCenter<MeshType> > ClusteringGrid;
+        ClusteringGrid.Init(mesh.bbox,1,cellSize);
+        ClusteringGrid.AddMesh(mesh);
+        ClusteringGrid.ExtractMesh(proxy);
+        vcg::tri::Clean<MeshType>::RemoveDuplicateVertex(proxy);
+        vcg::tri::Clean<MeshType>::RemoveDuplicateFace(proxy);
+        vcg::tri::Clean<MeshType>::RemoveDegenerateFace(proxy);
+        vcg::tri::Allocator<MeshType>::CompactEveryVector(proxy);
+    }
+
+    //vertex clustering of the mesh to about targetFaces faces, cleaned to a manifold triangle mesh
+    static void BuildProxy(MeshType &mesh,size_t targetFaces,MeshType &proxy)
+    {
+        vcg::tri::UpdateBounding<MeshType>::Box(mesh);
+        targetFaces=std::max<size_t>(targetFaces,1);
+        //the cell edge of a uniform triangulation of the surface with targetFaces faces,
+        //Init(box,size) would take a number of 3D cells, most of them empty
+        const ScalarType Area=vcg::tri::Stat<MeshType>::ComputeMeshArea(mesh);
+        ScalarType cellSize=std::sqrt(2.309*Area/targetFaces);
+        if (!(cellSize>0))
+            cellSize=mesh.bbox.Diag()/std::sqrt((ScalarType)targetFaces);
+        ClusterMesh(mesh,cellSize,proxy);
+        //the occupied cells depend on how the surface crosses the grid, correct the cell size
+        //from the actual count if it is off by more than a quarter
+        for (int step=0;step<3;step++)
+        {
+            const ScalarType ratio=(ScalarType)proxy.fn/(ScalarType)targetFaces;
+            if ((proxy.fn==0)||((ratio>0.75)&&(ratio<1.25)))break;
+            cellSize*=std::sqrt(ratio);
+            ClusterMesh(mesh,cellSize,proxy);
+        }
+
+        vcg::tri::UpdateTopology<MeshType>::FaceFace(proxy);
+        vcg::tri::Clean<MeshType>::RemoveNonManifoldFace(proxy);
+        vcg::tri::Clean<MeshType>::RemoveUnreferencedVertex(proxy);
+        vcg::tri::Allocator<MeshType>::CompactEveryVector(proxy);
+        vcg::tri::UpdateTopology<MeshType>::FaceFace(proxy);
+        vcg::tri::UpdateNormal<MeshType>::PerFaceNormalized(proxy);
+        vcg::tri::UpdateNormal<MeshType>::PerVertexNormalized(proxy);
+        vcg::tri::UpdateBounding<MeshType>::Box(proxy);
+    }
+
+    //projects dir on the plane of f, returns false if it is (almost) orthogonal to it
+    static bool TangentDir(const FaceType &f,CoordType &dir)
+    {
+        CoordType N=f.cN();
+        N.Normalize();
+        dir-=N*(dir*N);
+        if (dir.Norm()<1e-8)return false;
+        dir.Normalize();
+        return true;
+    }
+
+    //the representative of the Ndir-symmetric direction dir closest to ref
+    static CoordType ClosestRepresentative(const CoordType &dir,
+                                           const CoordType &ref,
+                                           const CoordType &N,
+                                           int Ndir)
+    {
+        CoordType best=(dir*ref>=0)?dir:-dir;
+        if (Ndir==4)
+        {
+            CoordType rot=N^dir;
+            if (rot*ref<0)rot=-rot;
+            if (rot*ref>best*ref)best=rot;
+        }
+        return best;
+    }
+
+    static void SetFaceDir(FaceType &f,CoordType dir1)
+    {
+        CoordType dir2=f.N()^dir1;
+        dir2.Normalize();
+        ScalarType Norm1=f.PD1().Norm();
+        ScalarType Norm2=f.PD2().Norm();
+        f.PD1()=dir1*Norm1;
+        f.PD2()=dir2*Norm2;
+    }
+
+    //Jacobi sweeps averaging each free face with its edge neighbours,
+    //selected faces (hard constraints) are kept
+    static void LocalSmoothSweeps(MeshType &mesh,int Ndir,size_t sweeps)
+    {
+        std::vector<CoordType> NewDir(mesh.face.size());
+        for (size_t s=0;s<sweeps;s++)
+        {
+            for (size_t i=0;i<mesh.face.size();i++)
+            {
+                FaceType &f=mesh.face[i];
+                NewDir[i]=f.PD1();
+                if (f.IsD()||f.IsS())continue;
+
+                CoordType N=f.N();
+                N.Normalize();
+                CoordType ref=f.PD1();
+                if (!TangentDir(f,ref))continue;
+
+                CoordType avg=ref;
+                for (int j=0;j<f.VN();j++)
+                {
+                    FaceType *fo=f.FFp(j);
+                    if (fo==&f)continue;
+                    CoordType dir=fo->PD1();
+                    if (!TangentDir(f,dir))continue;
+                    avg+=ClosestRepresentative(dir,ref,N,Ndir);
+                }
+                if (TangentDir(f,avg))
+                    NewDir[i]=avg;
+            }
+            for (size_t i=0;i<mesh.face.size();i++)
+            {
+                FaceType &f=mesh.face[i];
+                if (f.IsD()||f.IsS())continue;
+                CoordType dir=NewDir[i];
+                if (!TangentDir(f,dir))continue;
+                SetFaceDir(f,dir);
+            }
+        }
+    }
+
+    //solves on a proxy of about SParam.hierarchy_faces faces, transfers the
+    //field to the mesh by closest faces, then smooths locally; memory is
+    //linear in the number of faces of the mesh
+    static void SmoothDirectionsHierarchical(MeshType &mesh,SmoothParam &SParam)
+    {
+        MeshType proxy;
+        BuildProxy(mesh,SParam.hierarchy_faces,proxy);
+        std::cout<<"Hierarchical field: proxy of "<<proxy.fn<<" faces (target "<<SParam.hierarchy_faces<<") for "<<mesh.fn<<" faces"<<std::endl;
+        if (proxy.fn==0)
+        {
+            SmoothDirectionsIGL(mesh,SParam.Ndir,SParam.SmoothM,true,SParam.alpha_curv);
+            return;
+        }
+
+        //face correspondence mesh -> proxy
+        vcg::GridStaticPtr<FaceType,ScalarType> ProxyGrid;
+        vcg::Box3<ScalarType> BB=proxy.bbox;
+        BB.Offset(BB.Diag()*0.1);
+        ProxyGrid.Set(proxy.face.begin(),proxy.face.end(),BB);
+        ScalarType MaxD=mesh.bbox.Diag();
+        std::vector<FaceType*> ProxyF(mesh.face.size(),NULL);
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (mesh.face[i].IsD())continue;
+            CoordType TestPos=(mesh.face[i].P(0)+mesh.face[i].P(1)+mesh.face[i].P(2))/3;
+            CoordType closestPt;
+            ScalarType MinD;
+            ProxyF[i]=vcg::tri::GetClosestFaceBase(proxy,ProxyGrid,TestPos,MaxD,MinD,closestPt);
+        }
+
+        //initial directions and soft constraints of the proxy
+        if ((SParam.alpha_curv>0)||(SParam.curv_thr>0))
+            InitByCurvature(proxy,SParam.curvRing,true,SParam.num_threads);
+        else
+        {
+            for (size_t i=0;i<proxy.face.size();i++)
+            {
+                CoordType N=proxy.face[i].N();
+                CoordType Dir=CoordType(1,0,0);
+                if (fabs(Dir*N)>0.9)Dir=CoordType(0,1,0);
+                Dir=N^Dir;
+                Dir.Normalize();
+                proxy.face[i].PD1()=Dir;
+                proxy.face[i].PD2()=N^Dir;
+            }
+        }
+
+        //hard constraints of the mesh restrict the proxy face they fall on
+        vcg::tri::UpdateFlags<MeshType>::FaceClear(proxy);
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (ProxyF[i]==NULL)continue;
+            if (!mesh.face[i].IsS())continue;
+            FaceType &pf=*ProxyF[i];
+            if (pf.IsS())continue;
+            CoordType dir=mesh.face[i].PD1();
+            if (!TangentDir(pf,dir))continue;
+            pf.PD1()=dir;
+            pf.PD2()=pf.N()^dir;
+            pf.PD2().Normalize();
+            pf.SetS();
+        }
+
+        SmoothDirectionsIGL(proxy,SParam.Ndir,SParam.SmoothM,true,SParam.alpha_curv);
+
+        //prolongation
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (ProxyF[i]==NULL)continue;
+            if (mesh.face[i].IsS())continue;
+            CoordType dir=ProxyF[i]->PD1();
+            if (!TangentDir(mesh.face[i],dir))continue;
+            SetFaceDir(mesh.face[i],dir);
+        }
+
+        LocalSmoothSweeps(mesh,SParam.Ndir,SParam.hierarchy_sweeps);
+    }
+
 public:
 
     static void SmoothDirections(MeshType &mesh,SmoothParam SParam)
@@ -521,7 +720,7 @@ public:
                     (SParam.sharp_thr>0)||
                     (SParam.curv_thr>0))
             {
-                InitByCurvature(mesh,SParam.curvRing);
+                InitByCurvature(mesh,SParam.curvRing,true,SParam.num_threads);
                 SelectConstraints(mesh,SParam);
             }
             else
@@ -529,13 +728,16 @@ public:
                 SelectConstraints(mesh,SParam);
                 vcg::tri::CrossField<MeshType>::PropagateFromSelF(mesh);
             }
-            SmoothDirectionsIGL(mesh,SParam.Ndir,SParam.SmoothM,true,SParam.alpha_curv);
+            if ((SParam.hierarchy_faces>0)&&((size_t)mesh.fn>SParam.hierarchy_faces))
+                SmoothDirectionsHierarchical(mesh,SParam);
+            else
+                SmoothDirectionsIGL(mesh,SParam.Ndir,SParam.SmoothM,true,SParam.alpha_curv);
         }
         else
         {
             std::cout<<"ITERATIVE"<<std::endl;
             assert(SParam.SmoothM==SMIterative);
-            InitByCurvature(mesh,SParam.curvRing);
+            InitByCurvature(mesh,SParam.curvRing,true,SParam.num_threads);
 
             if ((SParam.sharp_thr>0)||(SParam.curv_thr>0))
                 SelectConstraints(mesh,SParam);
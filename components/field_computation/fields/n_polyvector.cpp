@@ -12,12 +12,12 @@
 #include "igl/edge_topology.h"
 #include "igl/local_basis.h"
 #include "igl/nchoosek.h"
-#include "igl/slice.h"
 #include "igl/igl_inline.h"
 
 #include "polyroots.h"
 
 #include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
 
 #include <Eigen/Geometry>
 #include <iostream>
@@ -28,6 +28,10 @@ namespace igl {
   class PolyVectorFieldFinder
   {
   private:
+    typedef std::complex<typename DerivedV::Scalar> Complex;
+    typedef Eigen::SparseMatrix<Complex> ComplexSparse;
+    typedef Eigen::Matrix<Complex, Eigen::Dynamic, 1> ComplexVector;
+
     const Eigen::PlainObjectBase<DerivedV> &V;
     const Eigen::PlainObjectBase<DerivedF> &F; int numF;
     const int n;
@@ -45,6 +49,14 @@ namespace igl {
 
     DerivedV B1, B2, FN;
 
+    // The coefficient Laplacians of all degrees are Hermitian and share their
+    // sparsity pattern, so the symbolic factorization of the unknown block is
+    // computed once per constraint set and reused across degrees and solves.
+    Eigen::VectorXi factorizedConstrained;
+    Eigen::VectorXi indFullToReduced; // index among the unknown resp. known faces
+    int numUnknown;
+    Eigen::SimplicialLDLT<ComplexSparse> ldlt;
+
     IGL_INLINE void computek();
     IGL_INLINE void setFieldFromGeneralCoefficients(const  std::vector<Eigen::Matrix<std::complex<typename DerivedV::Scalar>, Eigen::Dynamic,1> > &coeffs,
                                                     std::vector<Eigen::Matrix<typename DerivedV::Scalar, Eigen::Dynamic, 2> > &pv);
@@ -56,11 +68,11 @@ namespace igl {
     IGL_INLINE void precomputeInteriorEdges();
 
 
-    IGL_INLINE void minQuadWithKnownMini(const Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > &Q,
-                                         const Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > &f,
-                                         const Eigen::VectorXi isConstrained,
-                                         const Eigen::Matrix<std::complex<typename DerivedV::Scalar>, Eigen::Dynamic, 1> &xknown,
-                                         Eigen::Matrix<std::complex<typename DerivedV::Scalar>, Eigen::Dynamic, 1> &x);
+    IGL_INLINE void minQuadWithKnownMini(const ComplexSparse &Q,
+                                         const ComplexVector &f,
+                                         const Eigen::VectorXi &isConstrained,
+                                         const ComplexVector &xknown,
+                                         ComplexVector &x);
 
   public:
     IGL_INLINE PolyVectorFieldFinder(const Eigen::PlainObjectBase<DerivedV> &_V,
@@ -81,7 +93,8 @@ IGL_INLINE igl::PolyVectorFieldFinder<DerivedV, DerivedF>::
 V(_V),
 F(_F),
 numF(_F.rows()),
-n(_n)
+n(_n),
+numUnknown(0)
 {
 
   igl::edge_topology(V,F,EV,F2E,E2F);
@@ -134,67 +147,74 @@ precomputeInteriorEdges()
 
 template<typename DerivedV, typename DerivedF>
 IGL_INLINE void igl::PolyVectorFieldFinder<DerivedV, DerivedF>::
-minQuadWithKnownMini(const Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > &Q,
-                          const Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > &f,
-                     const Eigen::VectorXi isConstrained,
-                          const Eigen::Matrix<std::complex<typename DerivedV::Scalar>, Eigen::Dynamic, 1> &xknown,
-                          Eigen::Matrix<std::complex<typename DerivedV::Scalar>, Eigen::Dynamic, 1> &x)
+minQuadWithKnownMini(const ComplexSparse &Q,
+                     const ComplexVector &f,
+                     const Eigen::VectorXi &isConstrained,
+                     const ComplexVector &xknown,
+                     ComplexVector &x)
 {
+  // minimizes x^H Q x - Re(f^H x) with x fixed on the constrained entries:
+  //   Quu xu = -(Quk xk + .5 fu)
   int N = Q.rows();
-
   int nc = xknown.rows();
-  Eigen::VectorXi known; known.setZero(nc,1);
-  Eigen::VectorXi unknown; unknown.setZero(N-nc,1);
 
-  int indk = 0, indu = 0;
-  for (int i = 0; i<N; ++i)
-    if (isConstrained[i])
-    {
-      known[indk] = i;
-      indk++;
-    }
-    else
+  bool newPattern = (factorizedConstrained.size() != N) || (factorizedConstrained != isConstrained);
+  if (newPattern)
+  {
+    indFullToReduced.resize(N);
+    int indk = 0, indu = 0;
+    for (int i = 0; i<N; ++i)
+      indFullToReduced[i] = isConstrained[i] ? indk++ : indu++;
+    numUnknown = indu;
+    assert(indk == nc);
+  }
+
+  // split Q into the unknown-unknown and unknown-known blocks in one pass
+  std::vector<Eigen::Triplet<Complex> > tripletsUU, tripletsUK;
+  tripletsUU.reserve(Q.nonZeros());
+  for (int k = 0; k<Q.outerSize(); ++k)
+    for (typename ComplexSparse::InnerIterator it(Q,k); it; ++it)
     {
-      unknown[indu] = i;
-      indu++;
+      if (isConstrained[it.row()])
+        continue;
+      int r = indFullToReduced[it.row()];
+      int c = indFullToReduced[it.col()];
+      if (isConstrained[it.col()])
+        tripletsUK.push_back(Eigen::Triplet<Complex>(r, c, it.value()));
+      else
+        tripletsUU.push_back(Eigen::Triplet<Complex>(r, c, it.value()));
     }
+  ComplexSparse Quu(numUnknown, numUnknown), Quk(numUnknown, nc);
+  Quu.setFromTriplets(tripletsUU.begin(), tripletsUU.end());
+  Quk.setFromTriplets(tripletsUK.begin(), tripletsUK.end());
 
-  Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > Quu, Quk;
-
-  igl::slice(Q,unknown, unknown, Quu);
-  igl::slice(Q,unknown, known, Quk);
-
-
-  std::vector<typename Eigen::Triplet<std::complex<typename DerivedV::Scalar> > > tripletList;
-
-  Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > fu(N-nc,1);
-
-  igl::slice(f,unknown, Eigen::VectorXi::Zero(1,1), fu);
-
-  Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > rhs = (Quk*xknown).sparseView()+.5*fu;
+  ComplexVector rhs = -(Quk*xknown);
+  for (int i = 0; i<N; ++i)
+    if (!isConstrained[i])
+      rhs[indFullToReduced[i]] -= .5*f[i];
 
-  Eigen::SparseLU< Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > > solver;
-  solver.compute(-Quu);
-  if(solver.info()!=Eigen::Success)
+  if (newPattern)
+  {
+    ldlt.analyzePattern(Quu);
+    factorizedConstrained = isConstrained;
+  }
+  ldlt.factorize(Quu);
+  if(ldlt.info()!=Eigen::Success)
   {
     std::cerr<<"Decomposition failed!"<<std::endl;
+    factorizedConstrained.resize(0);
     return;
   }
-  Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> >  b  = solver.solve(rhs);
-  if(solver.info()!=Eigen::Success)
+  ComplexVector b = ldlt.solve(rhs);
+  if(ldlt.info()!=Eigen::Success)
   {
     std::cerr<<"Solving failed!"<<std::endl;
     return;
   }
 
-  indk = 0, indu = 0;
-  x.setZero(N,1);
+  x.resize(N);
   for (int i = 0; i<N; ++i)
-    if (isConstrained[i])
-      x[i] = xknown[indk++];
-    else
-      x[i] = b.coeff(indu++,0);
-
+    x[i] = isConstrained[i] ? xknown[indFullToReduced[i]] : b[indFullToReduced[i]];
 }
 
 
@@ -228,7 +248,7 @@ IGL_INLINE bool igl::PolyVectorFieldFinder<DerivedV, DerivedF>::
 
     Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > DD;
     computeCoefficientLaplacian(degree, DD);
-    Eigen::SparseMatrix<std::complex<typename DerivedV::Scalar> > f; f.resize(numF,1);
+    ComplexVector f = ComplexVector::Zero(numF);
 
     minQuadWithKnownMini(DD, f, isConstrained, Ck, coeffs[i]);
   }
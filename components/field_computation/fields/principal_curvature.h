@@ -0,0 +1,288 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef QR_PRINCIPAL_CURVATURE_H
+#define QR_PRINCIPAL_CURVATURE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Dense>
+
+#include <vcg/complex/complex.h>
+
+#include <quadretopology/includes/qr_parallel.h>
+
+#include "connectivity_cache.h"
+
+namespace vcg {
+namespace tri {
+
+//Principal curvature by local quadric fitting on the n-ring of each vertex,
+//same estimator as igl::principal_curvature(V,F,PD1,PD2,PV1,PV2,Nring,true).
+//The vertex adjacency is stored as CSR in a per mesh attribute and reused while
+//the connectivity does not change, the fits run in parallel over the vertices
+//and the result goes directly to PD1/PD2/K1/K2 of the vertices.
+template <class MeshType>
+class PrincipalCurvature
+{
+    typedef typename MeshType::VertexType VertexType;
+    typedef typename MeshType::FaceType FaceType;
+    typedef typename MeshType::ScalarType ScalarType;
+    typedef typename MeshType::CoordType CoordType;
+
+public:
+
+    struct RingIndex
+    {
+        //neighbours of vertex i are Adj[Offset[i]..Offset[i+1]), sorted
+        std::vector<int> Offset;
+        std::vector<int> Adj;
+    };
+
+private:
+
+    static void BuildRingIndex(MeshType &mesh,RingIndex &RI)
+    {
+        const size_t nV=mesh.vert.size();
+        std::vector<int> Degree(nV+1,0);
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (mesh.face[i].IsD())continue;
+            for (int j=0;j<3;j++)
+                Degree[vcg::tri::Index(mesh,mesh.face[i].cV(j))]+=2;
+        }
+        RI.Offset.assign(nV+1,0);
+        for (size_t i=0;i<nV;i++)
+            RI.Offset[i+1]=RI.Offset[i]+Degree[i];
+        RI.Adj.resize(RI.Offset[nV]);
+        std::vector<int> Pos(RI.Offset.begin(),RI.Offset.end()-1);
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (mesh.face[i].IsD())continue;
+            for (int j=0;j<3;j++)
+            {
+                int s=vcg::tri::Index(mesh,mesh.face[i].cV(j));
+                int d=vcg::tri::Index(mesh,mesh.face[i].cV((j+1)%3));
+                RI.Adj[Pos[s]++]=d;
+                RI.Adj[Pos[d]++]=s;
+            }
+        }
+        //sort and remove duplicates, then compact
+        int curr=0;
+        for (size_t i=0;i<nV;i++)
+        {
+            std::vector<int>::iterator b=RI.Adj.begin()+RI.Offset[i];
+            std::vector<int>::iterator e=RI.Adj.begin()+RI.Offset[i+1];
+            std::sort(b,e);
+            e=std::unique(b,e);
+            RI.Offset[i]=curr;
+            curr=std::copy(b,e,RI.Adj.begin()+curr)-RI.Adj.begin();
+        }
+        RI.Offset[nV]=curr;
+        RI.Adj.resize(curr);
+        RI.Adj.shrink_to_fit();
+    }
+
+    static const RingIndex &GetRingIndex(MeshType &mesh)
+    {
+        return ConnectivityCache<MeshType>::template Get<RingIndex>(mesh,"PrincipalCurvatureRingIndex",BuildRingIndex);
+    }
+
+    //breadth first, the vertex itself comes first
+    static void GetNRing(const RingIndex &RI,int v,int Nring,std::vector<int> &Ring)
+    {
+        Ring.clear();
+        Ring.push_back(v);
+        size_t begin=0;
+        for (int d=0;d<Nring;d++)
+        {
+            size_t end=Ring.size();
+            for (size_t k=begin;k<end;k++)
+                for (int n=RI.Offset[Ring[k]];n<RI.Offset[Ring[k]+1];n++)
+                {
+                    int neigh=RI.Adj[n];
+                    //rings are small, a linear search is cheaper than a visited array per thread
+                    if (std::find(Ring.begin(),Ring.end(),neigh)==Ring.end())
+                        Ring.push_back(neigh);
+                }
+            begin=end;
+        }
+    }
+
+    struct Scratch
+    {
+        std::vector<int> Ring;
+        std::vector<int> RingTmp;
+        Eigen::MatrixXd A;
+        Eigen::VectorXd b;
+    };
+
+    static void FitVertex(const std::vector<Eigen::Vector3d> &Pos,
+                          const std::vector<Eigen::Vector3d> &Norm,
+                          const RingIndex &RI,
+                          int i,
+                          int Nring,
+                          Scratch &S,
+                          Eigen::Vector3d &PD1,
+                          Eigen::Vector3d &PD2,
+                          double &K1,
+                          double &K2)
+    {
+        PD1.setZero();
+        PD2.setZero();
+        K1=K2=0;
+
+        GetNRing(RI,i,Nring,S.Ring);
+        if (S.Ring.size()<6)return;
+
+        //only keep the neighbours facing the same side
+        const Eigen::Vector3d &normal=Norm[i];
+        S.RingTmp.clear();
+        for (size_t k=0;k<S.Ring.size();k++)
+            if (Norm[S.Ring[k]].dot(normal)>0)
+                S.RingTmp.push_back(S.Ring[k]);
+        if ((S.RingTmp.size()>=6)&&(S.RingTmp.size()<S.Ring.size()))
+            S.Ring.swap(S.RingTmp);
+
+        //reference frame
+        const Eigen::Vector3d &me=Pos[i];
+        const Eigen::Vector3d &first=Pos[RI.Adj[RI.Offset[i]]];
+        Eigen::Vector3d ref0=(first-normal*((first-me).dot(normal))-me).normalized();
+        Eigen::Vector3d ref1=normal.cross(ref0).normalized();
+
+        //quadric z = a u^2 + b uv + c v^2 + d u + e v
+        const int m=S.Ring.size();
+        S.A.resize(m,5);
+        S.b.resize(m);
+        for (int k=0;k<m;k++)
+        {
+            Eigen::Vector3d vTang=Pos[S.Ring[k]]-me;
+            double u=vTang.dot(ref0);
+            double v=vTang.dot(ref1);
+            S.A(k,0)=u*u;
+            S.A(k,1)=u*v;
+            S.A(k,2)=v*v;
+            S.A(k,3)=u;
+            S.A(k,4)=v;
+            S.b(k)=vTang.dot(normal);
+        }
+        Eigen::Matrix<double,5,1> q=S.A.jacobiSvd(Eigen::ComputeThinU|Eigen::ComputeThinV).solve(S.b);
+        const double a=q(0),b=q(1),c=q(2),d=q(3),e=q(4);
+
+        double E=1.0+d*d;
+        double F=d*e;
+        double G=1.0+e*e;
+        Eigen::Vector3d n=Eigen::Vector3d(-d,-e,1.0).normalized();
+        double L=2.0*a*n[2];
+        double M=b*n[2];
+        double N=2*c*n[2];
+
+        Eigen::Matrix2d W;
+        W << L*G-M*F, M*E-L*F, M*E-L*F, N*E-M*F;
+        W=W/(E*G-F*F);
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eig(W);
+        Eigen::Vector2d c_val=-eig.eigenvalues();
+        Eigen::Matrix2d c_vec=eig.eigenvectors();
+
+        Eigen::Vector3d v1=(ref0*c_vec(0)+ref1*c_vec(1)).normalized()*c_val(0);
+        Eigen::Vector3d v2=(ref0*c_vec(2)+ref1*c_vec(3)).normalized()*c_val(1);
+        if (c_val(0)>c_val(1))
+        {
+            std::swap(v1,v2);
+            std::swap(c_val(0),c_val(1));
+        }
+        K1=c_val(0);
+        K2=c_val(1);
+        PD1=v1.normalized();
+        PD2=v2.normalized();
+        if (!PD1.allFinite()||!PD2.allFinite())
+        {
+            PD1.setZero();
+            PD2.setZero();
+        }
+        if (PD1.dot(PD2)>10e-6)
+        {
+            PD1.setZero();
+            PD2.setZero();
+        }
+    }
+
+public:
+
+    static void Compute(MeshType &mesh,int Nring,int numThreads=1)
+    {
+        tri::RequirePerVertexCurvatureDir(mesh);
+
+        const RingIndex &RI=GetRingIndex(mesh);
+        const size_t nV=mesh.vert.size();
+
+        //positions and area weighted normals
+        std::vector<Eigen::Vector3d> Pos(nV);
+        std::vector<Eigen::Vector3d> Norm(nV,Eigen::Vector3d::Zero());
+        for (size_t i=0;i<nV;i++)
+        {
+            const CoordType &P=mesh.vert[i].cP();
+            Pos[i]=Eigen::Vector3d(P.X(),P.Y(),P.Z());
+        }
+        for (size_t i=0;i<mesh.face.size();i++)
+        {
+            if (mesh.face[i].IsD())continue;
+            int v0=vcg::tri::Index(mesh,mesh.face[i].cV(0));
+            int v1=vcg::tri::Index(mesh,mesh.face[i].cV(1));
+            int v2=vcg::tri::Index(mesh,mesh.face[i].cV(2));
+            Eigen::Vector3d FN=(Pos[v1]-Pos[v0]).cross(Pos[v2]-Pos[v0]);
+            Norm[v0]+=FN;
+            Norm[v1]+=FN;
+            Norm[v2]+=FN;
+        }
+        for (size_t i=0;i<nV;i++)
+            Norm[i].normalize();
+
+        const size_t BlockSize=256;
+        const size_t nBlocks=(nV+BlockSize-1)/BlockSize;
+        std::vector<Scratch> S(QuadRetopology::internal::numWorkerThreads(numThreads,nBlocks));
+        QuadRetopology::internal::parallelForWorkers(nBlocks,numThreads,[&](const size_t block,const size_t worker)
+        {
+            for (size_t i=block*BlockSize;i<std::min(nV,(block+1)*BlockSize);i++)
+            {
+                VertexType &v=mesh.vert[i];
+                if (v.IsD())continue;
+                Eigen::Vector3d PD1,PD2;
+                double K1,K2;
+                FitVertex(Pos,Norm,RI,i,Nring,S[worker],PD1,PD2,K1,K2);
+                v.PD1()=CoordType(PD1(0),PD1(1),PD1(2));
+                v.PD2()=CoordType(PD2(0),PD2(1),PD2(2));
+                v.K1()=K1;
+                v.K2()=K2;
+            }
+        });
+    }
+};
+
+} // end namespace tri
+} // end namespace vcg
+#endif // QR_PRINCIPAL_CURVATURE_H
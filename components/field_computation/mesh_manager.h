@@ -45,6 +45,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <vcg/complex/algorithms/polygonal_algorithms.h>
 
 #include "fields/field_smoother.h"
+#include "face_geometry.h"
 
 // Basic subdivision class
 template <class FaceType>
@@ -139,6 +140,30 @@ class MeshPrepocess
         return true;
     }
 
+    //the checks below let the cleaning passes skip their mesh copies, refinements and topology
+    //updates when there is nothing to fix, as it happens for most passes after the first step
+    //same test as IsFold on every edge, with the normals of the current positions
+    static bool HasFolds(MeshType &mesh,ScalarType MinDot=-0.99)
+    {
+        typename vcg::tri::FaceGeometry<MeshType>::Snapshot S;
+        typename vcg::tri::FaceGeometry<MeshType>::ArrayX N[3],D[3];
+        vcg::tri::FaceGeometry<MeshType>::Update(mesh,S,1,true);
+        vcg::tri::FaceGeometry<MeshType>::Normals(S,N);
+        vcg::tri::FaceGeometry<MeshType>::NormalDots(S,N,D);
+        for (size_t j=0;j<3;j++)
+            if ((D[j]<=MinDot).any())return true;
+        return false;
+    }
+
+    static bool HasColinearFaces(MeshType &mesh,const ScalarType colinearThr)
+    {
+        typename vcg::tri::FaceGeometry<MeshType>::Snapshot S;
+        typename vcg::tri::FaceGeometry<MeshType>::ArrayX Q;
+        vcg::tri::FaceGeometry<MeshType>::Update(mesh,S);
+        vcg::tri::FaceGeometry<MeshType>::QualityRadii(S,Q);
+        return ((Q.head(mesh.FN())<=colinearThr).any());
+    }
+
     typedef SplitLev<FaceType> SplitLevType;
     typedef EdgePred<FaceType> EdgePredType;
 
@@ -147,6 +172,11 @@ class MeshPrepocess
                            bool debugmsg=false)
     {
         mesh.InitFeatureCoordsTable();
+        if (!HasFolds(mesh,MinDot))
+        {
+            mesh.SetFeatureFromTable();
+            return false;
+        }
 
         //then save the edges to be splitted
         std::map<CoordPair,CoordType> ToBeSplitted;
@@ -251,10 +281,16 @@ class MeshPrepocess
         int zeroAFace=0;
         bool modified=false;
         ScalarType Magnitudo=2;
+        typename vcg::tri::FaceGeometry<MeshType>::Snapshot S;
+        typename vcg::tri::FaceGeometry<MeshType>::ArrayX A;
         do{
             modified=false;
+            vcg::tri::FaceGeometry<MeshType>::Update(mesh,S);
+            vcg::tri::FaceGeometry<MeshType>::DoubleArea(S,A);
             for (size_t i=0;i<mesh.face.size();i++)
             {
+                //checked again as the vertices may have moved with a previous face
+                if (A[i]>0)continue;
                 if (vcg::DoubleArea(mesh.face[i])>0)continue;
                 Perturb(*mesh.face[i].V(0),Magnitudo);
                 Perturb(*mesh.face[i].V(1),Magnitudo);
@@ -264,6 +300,9 @@ class MeshPrepocess
             }
             Magnitudo*=2;
         }while (modified);
+        //the data structures are up to date when nothing moved
+        if (zeroAFace==0)
+            return modified;
         vcg::tri::Allocator<MeshType>::CompactEveryVector(mesh);
 
         if (debugmsg)
@@ -429,6 +468,13 @@ class MeshPrepocess
 
         mesh.InitFeatureCoordsTable();
 
+        if (!HasFolds(mesh,MinDot))
+        {
+            mesh.SetFeatureFromTable();
+            SetBorderSharp(mesh);
+            return false;
+        }
+
         for (size_t i=0;i<mesh.face.size();i++)
             for (size_t j=0;j<3;j++)
                 mesh.face[i].ClearFaceEdgeS(j);
@@ -456,39 +502,38 @@ class MeshPrepocess
 
         for (size_t i=NumV0;i<NumV1;i++)
             mesh.vert[i].P()+=mesh.vert[i].N()*AvgEdge*0.00001;
+        //normals and box after the displacement, the next passes rely on them
+        if (NumV1>NumV0)
+            mesh.UpdateDataStructures();
 
         mesh.SetFeatureFromTable();
+        SetBorderSharp(mesh);
+        return (NumV1>NumV0);
+    }
+
+    static void SetBorderSharp(MeshType &mesh)
+    {
         for (size_t i=0;i<mesh.face.size();i++)
             for (size_t j=0;j<(int)mesh.face[i].VN();j++)
             {
                 if (!vcg::face::IsBorder(mesh.face[i],j))continue;
                 mesh.face[i].SetFaceEdgeS(j);
             }
-        return (NumV1>NumV0);
     }
 
 
-    static bool RemoveNonManifold(MeshType &mesh)
+    static bool RemoveNonManifold(MeshType &mesh,int numThreads=1)
     {
-        bool modified=false;
-        ScalarType interval=std::numeric_limits<float>::epsilon()*10;
-        int i = 0;
-        int removed = 0;
-        int max_step=50;
-        do
-        {
-            modified| vcg::tri::Clean<MeshType>::SplitNonManifoldVertex(mesh,interval);
-            std::cout << "removed " << removed << " non manifold vertices..." << std::endl;
-        }
-        while (removed > 0 && i < max_step);
-        return modified;
+        return RemoveNonManifolds(mesh,false,numThreads);
     }
 
     static bool MakeOrientable(MeshType &mesh)
     {
         bool oriented = false, orientable = false;
         vcg::tri::Clean<MeshType>::OrientCoherentlyMesh(mesh, oriented, orientable);
-        mesh.UpdateDataStructures();
+        //no face has been flipped otherwise
+        if (!oriented)
+            mesh.UpdateDataStructures();
         return (!orientable);
     }
 
@@ -505,25 +550,38 @@ class MeshPrepocess
     }
 
     static bool RemoveNonManifolds(MeshType &mesh,
-                                   bool debugMsg=false)
+                                   bool debugMsg=false,
+                                   int numThreads=1)
     {
-        int splitV = 0, openings = 0;
         bool modified=false;
         ScalarType interval=std::numeric_limits<float>::epsilon()*10;
+        //a single pass opens everything but fans that are joined around both
+        //ends of a non manifold edge, the few steps after handle those
+        size_t splitV=0;
+        size_t steps=0;
         do
         {
-            vcg::tri::UpdateTopology<MeshType>::FaceFace(mesh);
-            splitV = vcg::tri::Clean<MeshType>::SplitNonManifoldVertex(mesh,interval);
-            openings = AutoRemesher<MeshType>::openNonManifoldEdges(mesh, interval);
-            modified|=(openings>0);
+            splitV=AutoRemesher<MeshType>::RepairNonManifold(mesh,interval,numThreads,debugMsg);
+            modified|=(splitV>0);
+            steps++;
+        } while ((splitV>0)&&(steps<10));
 
-            if (debugMsg)
-                std::cout << "Opened " << openings << " non manifold edges" << std::endl;
+        if (!modified)
+            return false;
 
-        } while (splitV > 0 || openings > 0);
+        mesh.UpdateDataStructures();
 
-        if (modified)
+        //pinched sheets the fan split cannot separate
+        int openings=0;
+        while ((steps<10)&&(vcg::tri::Clean<MeshType>::CountNonManifoldEdgeFF(mesh)>0))
+        {
+            steps++;
+            openings=AutoRemesher<MeshType>::openNonManifoldEdges(mesh, interval);
+            if (debugMsg)
+                std::cout << "Opened " << openings << " non manifold edges" << std::endl;
+            if (openings==0)break;
             mesh.UpdateDataStructures();
+        }
 
         return modified;
     }
@@ -534,6 +592,13 @@ class MeshPrepocess
 
         vcg::tri::UpdateTopology<MeshType>::FaceFace(m);
 
+        //no copy and grid to project on if there is nothing to flip
+        if (!HasColinearFaces(m,colinearThr))
+        {
+            vcg::tri::UnMarkAll(m);
+            return false;
+        }
+
         MeshType projectMesh;
         vcg::tri::Append<MeshType, MeshType>::MeshCopy(projectMesh, m);
         vcg::tri::UpdateBounding<MeshType>::Box(projectMesh);
@@ -632,7 +697,7 @@ class MeshPrepocess
 
 public:
 
-    static bool SolveGeometricArtifactsStep(MeshType &mesh)
+    static bool SolveGeometricArtifactsStep(MeshType &mesh,int numThreads=1)
     {
         bool modified=false;
 
@@ -643,7 +708,7 @@ public:
         modified|=RemoveZeroAreaFaces(mesh);
 
         //SPLIT NON MANIFOLD FACES
-        modified|=RemoveNonManifolds(mesh);
+        modified|=RemoveNonManifolds(mesh,false,numThreads);
 
         //REMOVE MINIMAL CONNECTED COMPONENTS
         modified|=RemoveSmallComponents(mesh);
@@ -666,10 +731,10 @@ public:
 
 public:
 
-    static void SolveGeometricArtifacts(MeshType &mesh,size_t max_steps=10)
+    static void SolveGeometricArtifacts(MeshType &mesh,size_t max_steps=10,int numThreads=1)
     {
         size_t currS=0;
-        while ((SolveGeometricArtifactsStep(mesh))&&(currS<max_steps))
+        while ((SolveGeometricArtifactsStep(mesh,numThreads))&&(currS<max_steps))
             currS++;
 
         //AutoRemesher<MeshType>::collapseSurvivingMicroEdges(mesh,0.001, const ScalarType edgeRatio = 0.025);
@@ -717,6 +782,9 @@ public:
         size_t remesher_iterations=15;
         ScalarType remesher_aspect_ratio=0.3;
         ScalarType remesher_termination_delta = 10000;
+        int num_threads=1;
+        //>0: only remesh the faces with a QualityRadii below this and a few rings around them
+        ScalarType remesh_quality_thr=0;
     };
 
     static void BatchProcess(MeshType &mesh,BatchParam &BPar,
@@ -742,9 +810,13 @@ public:
             RemPar.targetAspect = BPar.remesher_aspect_ratio;
             RemPar.targetDeltaFN= BPar.remesher_termination_delta;
             RemPar.surfDistCheck = BPar.surf_dist_check;
+            RemPar.numThreads = BPar.num_threads;
 
             //AutoRemesher<MeshType>::Remesh2(mesh,RemPar);
-            AutoRemesher<MeshType>::RemeshAdapt(mesh,RemPar);
+            if (BPar.remesh_quality_thr>0)
+                AutoRemesher<MeshType>::RemeshSelective(mesh,RemPar,BPar.remesh_quality_thr);
+            else
+                AutoRemesher<MeshType>::RemeshAdapt(mesh,RemPar);
 
         }
         mesh.InitFeatureCoordsTable();
@@ -755,7 +827,7 @@ public:
 
 
         //SOLVE POSSIBLE GEOMETRIC ARTIFACTS AFTER REFINEMENT
-        MeshPrepocess<MeshType>::SolveGeometricArtifacts(mesh);
+        MeshPrepocess<MeshType>::SolveGeometricArtifacts(mesh,10,BPar.num_threads);
 
         //REFINE THE MESH IF NEEDED TO BE CONSISTENT WHEN COMPUTING FIELD
         MeshPrepocess<MeshType>::RefineIfNeeded(mesh);
@@ -772,7 +844,7 @@ public:
         MeshFieldSmoother<MeshType>::SmoothField(mesh,FieldParam);
     }
 
-    static void SaveAllData(MeshType &tri_mesh,const std::string &pathM)
+    static void SaveAllData(MeshType &tri_mesh,const std::string &pathM,bool binary=false)
     {
         std::string projM=pathM;
         size_t indexExt=projM.find_last_of(".");
@@ -784,8 +856,8 @@ public:
         std::cout<<"Saving Field TO:"<<fieldName.c_str()<<std::endl;
         std::cout<<"Saving Sharp TO:"<<sharpName.c_str()<<std::endl;
         tri_mesh.SaveTriMesh(meshName.c_str());
-        tri_mesh.SaveField(fieldName.c_str());
-        tri_mesh.SaveSharpFeatures(sharpName.c_str());
+        tri_mesh.SaveField(fieldName.c_str(),binary);
+        tri_mesh.SaveSharpFeatures(sharpName.c_str(),binary);
     }
 
 };
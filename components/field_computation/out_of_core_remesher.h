@@ -0,0 +1,458 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef OUT_OF_CORE_REMESHER_H
+#define OUT_OF_CORE_REMESHER_H
+
+#include "mesh_manager.h"
+#include "streaming_mesh_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Remeshing of inputs too big to be loaded as a whole. The input file is read in passes and
+//split in spatial tiles whose size follows the memory budget. Each tile is loaded on its own,
+//gets its sharp features and is remeshed by AutoRemesher::RemeshTile with the vertices shared
+//with other tiles locked, then it is written to disk. At the end the remeshed tiles are
+//stitched on the shared vertices. The strips along the cuts keep the input resolution, the
+//usual in core remeshing of the (now small) result takes care of them.
+//The sharp features of a tile also mark its cuts, as any border, so they are not kept: the
+//ones of the result are computed again on the stitched mesh.
+template <class MeshType>
+class OutOfCoreRemesher
+{
+    typedef typename MeshType::ScalarType ScalarType;
+    typedef typename MeshType::CoordType CoordType;
+    typedef typename MeshType::VertexType VertexType;
+    typedef typename MeshType::FaceType FaceType;
+
+    //face as stored in the temporary files
+    struct FaceRecord
+    {
+        uint32_t v[3];
+        uint32_t cell;
+    };
+
+    //regular grid on the bounding box, cells are grouped in tiles along a Morton curve
+    struct FineGrid
+    {
+        vcg::Point3d origin;
+        double cellSize=1;
+        int dims[3]={1,1,1};
+
+        void Init(const vcg::Box3d &box)
+        {
+            const size_t maxCells=size_t(1)<<21;
+            origin=box.min;
+            //at most 1024 cells per side, 10 bits of the Morton code each
+            cellSize=std::max(box.Dim()[box.MaxDim()]/1024,std::numeric_limits<double>::min());
+            while (true)
+            {
+                for (int i=0;i<3;i++)
+                    dims[i]=std::max(1,(int)std::ceil(box.Dim()[i]/cellSize));
+                if ((size_t)dims[0]*dims[1]*dims[2]<=maxCells)break;
+                cellSize*=1.26;
+            }
+        }
+
+        size_t NumCells()const {return (size_t)dims[0]*dims[1]*dims[2];}
+
+        uint32_t Cell(const vcg::Point3d &p)const
+        {
+            int c[3];
+            for (int i=0;i<3;i++)
+                c[i]=std::min(dims[i]-1,std::max(0,(int)((p[i]-origin[i])/cellSize)));
+            return (uint32_t)(c[0]+(size_t)dims[0]*(c[1]+(size_t)dims[1]*c[2]));
+        }
+
+        uint32_t Morton(uint32_t cell)const
+        {
+            uint32_t c[3];
+            c[0]=cell%dims[0];
+            c[1]=(cell/dims[0])%dims[1];
+            c[2]=cell/(dims[0]*dims[1]);
+            uint32_t code=0;
+            for (int b=0;b<10;b++)
+                for (int i=0;i<3;i++)
+                    code|=((c[i]>>b)&1)<<(3*b+i);
+            return code;
+        }
+    };
+
+public:
+
+    struct Param
+    {
+        //peak memory of the tiled stage
+        size_t memory_budget_mb=4096;
+        //prefix of the temporary files, e.g. the input name without extension
+        std::string tmp_prefix;
+        ScalarType sharp_feature_thr=35;
+        size_t feature_erode_dilate=4;
+        typename AutoRemesher<MeshType>::Params remesher;
+    };
+
+private:
+
+    //the remesher keeps a copy of the tile to project on, plus its grid and the topology
+    static size_t BytesPerTileFace()
+    {
+        return 4*(sizeof(FaceType)+sizeof(VertexType)/2);
+    }
+
+    static std::string TileFilename(const Param &par,size_t tile,bool remeshed)
+    {
+        return par.tmp_prefix+"_tile"+std::to_string(tile)+(remeshed?"_rem.bin":".bin");
+    }
+
+    template <class T>
+    static void WriteValue(std::ofstream &out,const T &val)
+    {
+        out.write(reinterpret_cast<const char*>(&val),sizeof(T));
+    }
+
+    template <class T>
+    static T ReadValue(std::ifstream &in)
+    {
+        T val;
+        in.read(reinterpret_cast<char*>(&val),sizeof(T));
+        return val;
+    }
+
+    static std::ofstream OpenOut(const std::string &filename)
+    {
+        std::ofstream out(filename,std::ios::binary);
+        if (!out)
+            throw std::runtime_error("cannot write temporary file "+filename);
+        return out;
+    }
+
+    static std::ifstream OpenIn(const std::string &filename)
+    {
+        std::ifstream in(filename,std::ios::binary);
+        if (!in)
+            throw std::runtime_error("cannot read temporary file "+filename);
+        return in;
+    }
+
+    //fills the empty tile from the global vertex indices of its faces and the positions in Pos
+    static void BuildTile(const std::vector<uint32_t> &TileFaces,
+                          const std::vector<double> &Pos,
+                          const Param &par,
+                          MeshType &tile)
+    {
+        std::vector<uint32_t> Verts(TileFaces);
+        std::sort(Verts.begin(),Verts.end());
+        Verts.erase(std::unique(Verts.begin(),Verts.end()),Verts.end());
+
+        vcg::tri::Allocator<MeshType>::AddVertices(tile,Verts.size());
+        vcg::tri::Allocator<MeshType>::AddFaces(tile,TileFaces.size()/3);
+        auto globalIndex=AutoRemesher<MeshType>::TileGlobalIndex(tile);
+        for (size_t i=0;i<Verts.size();i++)
+        {
+            tile.vert[i].P()=CoordType(Pos[3*Verts[i]],Pos[3*Verts[i]+1],Pos[3*Verts[i]+2]);
+            globalIndex[i]=(size_t)Verts[i]+1;
+        }
+        for (size_t i=0;i<tile.face.size();i++)
+            for (int j=0;j<3;j++)
+            {
+                size_t IndexV=std::lower_bound(Verts.begin(),Verts.end(),TileFaces[3*i+j])-Verts.begin();
+                tile.face[i].V(j)=&tile.vert[IndexV];
+            }
+
+        MeshPrepocess<MeshType>::InitSharpFeatures(tile,par.sharp_feature_thr,par.feature_erode_dilate);
+    }
+
+    //vertices with their global index + 1 if shared with other tiles (0 otherwise),
+    //then faces
+    static void SaveTile(MeshType &tile,const std::vector<bool> &cut,const std::string &filename)
+    {
+        vcg::tri::Allocator<MeshType>::CompactEveryVector(tile);
+        auto globalIndex=AutoRemesher<MeshType>::TileGlobalIndex(tile);
+        std::ofstream out=OpenOut(filename);
+        WriteValue<uint64_t>(out,tile.vert.size());
+        WriteValue<uint64_t>(out,tile.face.size());
+        for (size_t i=0;i<tile.vert.size();i++)
+        {
+            for (int k=0;k<3;k++)
+                WriteValue<double>(out,tile.vert[i].P()[k]);
+            const size_t g=globalIndex[i];
+            WriteValue<uint64_t>(out,((g>0)&&cut[g-1])?g:0);
+        }
+        for (size_t i=0;i<tile.face.size();i++)
+            for (int j=0;j<3;j++)
+                WriteValue<uint32_t>(out,vcg::tri::Index(tile,tile.face[i].V(j)));
+        if (!out)
+            throw std::runtime_error("failed to write temporary file "+filename);
+    }
+
+    static void AppendTile(const std::string &filename,
+                           std::unordered_map<size_t,size_t> &SharedToMesh,
+                           MeshType &mesh)
+    {
+        std::ifstream in=OpenIn(filename);
+        const size_t nV=ReadValue<uint64_t>(in);
+        const size_t nF=ReadValue<uint64_t>(in);
+
+        std::vector<CoordType> P(nV);
+        std::vector<size_t> Shared(nV);
+        for (size_t i=0;i<nV;i++)
+        {
+            double x=ReadValue<double>(in);
+            double y=ReadValue<double>(in);
+            double z=ReadValue<double>(in);
+            P[i]=CoordType(x,y,z);
+            Shared[i]=ReadValue<uint64_t>(in);
+        }
+
+        std::vector<size_t> ToMesh(nV);
+        size_t NewV=0;
+        for (size_t i=0;i<nV;i++)
+        {
+            if (Shared[i]>0)
+            {
+                auto it=SharedToMesh.find(Shared[i]);
+                if (it!=SharedToMesh.end())
+                {
+                    ToMesh[i]=it->second;
+                    continue;
+                }
+                SharedToMesh[Shared[i]]=mesh.vert.size()+NewV;
+            }
+            ToMesh[i]=mesh.vert.size()+NewV;
+            NewV++;
+        }
+
+        vcg::tri::Allocator<MeshType>::AddVertices(mesh,NewV);
+        auto fi=vcg::tri::Allocator<MeshType>::AddFaces(mesh,nF);
+        for (size_t i=0;i<nV;i++)
+            mesh.vert[ToMesh[i]].P()=P[i];
+        for (size_t i=0;i<nF;i++,++fi)
+            for (int j=0;j<3;j++)
+                (*fi).V(j)=&mesh.vert[ToMesh[ReadValue<uint32_t>(in)]];
+        if (!in)
+            throw std::runtime_error("failed to read temporary file "+filename);
+    }
+
+public:
+
+    //remeshes the mesh in filename (.obj or .ply) into mesh, returns false if it cannot be read
+    static bool Remesh(const std::string &filename,Param &par,MeshType &mesh)
+    {
+        //PASS 1: VERTEX POSITIONS, THE ONLY DATA KEPT FOR THE WHOLE INPUT
+        std::vector<double> Pos;
+        vcg::Box3d box;
+        bool read=StreamingMeshReader::Read(filename,
+                                            [&](double x,double y,double z)
+        {
+            Pos.push_back(x);
+            Pos.push_back(y);
+            Pos.push_back(z);
+            box.Add(vcg::Point3d(x,y,z));
+        },
+        [](size_t,size_t,size_t){});
+        const size_t numVert=Pos.size()/3;
+        if ((!read)||(numVert==0))return false;
+        if (numVert>std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("too many vertices for the out of core remesher");
+        Pos.shrink_to_fit();
+
+        //PASS 2: FACES TO A TEMPORARY FILE WITH THEIR CELL, AREA AND VOLUME
+        FineGrid grid;
+        grid.Init(box);
+        std::vector<uint32_t> CellFaces(grid.NumCells(),0);
+        const std::string facesFilename=par.tmp_prefix+"_faces.bin";
+        size_t numFaces=0;
+        double Area=0;
+        double Volume=0;
+        {
+            std::ofstream out=OpenOut(facesFilename);
+            bool valid=true;
+            read=StreamingMeshReader::Read(filename,
+                                           [](double,double,double){},
+                                           [&](size_t v0,size_t v1,size_t v2)
+            {
+                if ((v0>=numVert)||(v1>=numVert)||(v2>=numVert))
+                {
+                    valid=false;
+                    return;
+                }
+                vcg::Point3d P0(Pos[3*v0],Pos[3*v0+1],Pos[3*v0+2]);
+                vcg::Point3d P1(Pos[3*v1],Pos[3*v1+1],Pos[3*v1+2]);
+                vcg::Point3d P2(Pos[3*v2],Pos[3*v2+1],Pos[3*v2+2]);
+                FaceRecord rec;
+                rec.v[0]=(uint32_t)v0;
+                rec.v[1]=(uint32_t)v1;
+                rec.v[2]=(uint32_t)v2;
+                rec.cell=grid.Cell((P0+P1+P2)/3);
+                CellFaces[rec.cell]++;
+                Area+=((P1-P0)^(P2-P0)).Norm()/2;
+                Volume+=P0*(P1^P2)/6.0;
+                WriteValue(out,rec);
+                numFaces++;
+            });
+            if (!out)
+                throw std::runtime_error("failed to write temporary file "+facesFilename);
+            if ((!read)||(!valid)||(numFaces==0))
+            {
+                out.close();
+                std::remove(facesFilename.c_str());
+                return false;
+            }
+        }
+
+        //TILES: CONSECUTIVE CELLS ALONG THE MORTON CURVE UP TO THE FACES THE BUDGET ALLOWS
+        const size_t budget=par.memory_budget_mb*1024*1024;
+        const size_t fixedBytes=Pos.size()*sizeof(double)+numVert*(sizeof(int)+1)+CellFaces.size()*2*sizeof(uint32_t);
+        const size_t minTileFaces=10000;
+        size_t tileFaces=minTileFaces;
+        if (budget>fixedBytes)
+            tileFaces=std::max(minTileFaces,(budget-fixedBytes)/BytesPerTileFace());
+        else
+            std::cout<<"WARNING: the vertex positions alone exceed the memory budget"<<std::endl;
+
+        std::vector<std::pair<uint32_t,uint32_t> > CellOrder;
+        for (size_t i=0;i<CellFaces.size();i++)
+            if (CellFaces[i]>0)
+                CellOrder.push_back(std::make_pair(grid.Morton(i),(uint32_t)i));
+        std::sort(CellOrder.begin(),CellOrder.end());
+        std::vector<uint32_t> CellTile(CellFaces.size(),0);
+        size_t numTiles=0;
+        size_t currFaces=0;
+        for (size_t i=0;i<CellOrder.size();i++)
+        {
+            const uint32_t cell=CellOrder[i].second;
+            if ((currFaces>0)&&(currFaces+CellFaces[cell]>tileFaces))
+            {
+                numTiles++;
+                currFaces=0;
+            }
+            CellTile[cell]=numTiles;
+            currFaces+=CellFaces[cell];
+        }
+        numTiles++;
+        std::vector<uint32_t>().swap(CellFaces);
+        std::cout<<"Out of core remeshing: "<<numFaces<<" faces in "<<numTiles
+                 <<" tiles of at most about "<<tileFaces<<" faces"<<std::endl;
+
+        //PASS 3: FACES TO THE TILE FILES, VERTICES IN MORE THAN ONE TILE ARE CUT
+        std::vector<int> VertTile(numVert,-1);
+        std::vector<bool> Cut(numVert,false);
+        const size_t maxOpenFiles=256;
+        for (size_t first=0;first<numTiles;first+=maxOpenFiles)
+        {
+            const size_t last=std::min(numTiles,first+maxOpenFiles);
+            std::vector<std::ofstream> TileOut;
+            for (size_t t=first;t<last;t++)
+                TileOut.push_back(OpenOut(TileFilename(par,t,false)));
+            std::ifstream in=OpenIn(facesFilename);
+            for (size_t i=0;i<numFaces;i++)
+            {
+                const FaceRecord rec=ReadValue<FaceRecord>(in);
+                const size_t t=CellTile[rec.cell];
+                if (first==0)
+                    for (int j=0;j<3;j++)
+                    {
+                        if (VertTile[rec.v[j]]<0)
+                            VertTile[rec.v[j]]=t;
+                        else if (VertTile[rec.v[j]]!=(int)t)
+                            Cut[rec.v[j]]=true;
+                    }
+                if ((t<first)||(t>=last))continue;
+                WriteValue(TileOut[t-first],rec.v);
+            }
+            if (!in)
+                throw std::runtime_error("failed to read temporary file "+facesFilename);
+            for (size_t t=first;t<last;t++)
+                if (!TileOut[t-first])
+                    throw std::runtime_error("failed to write temporary file "+TileFilename(par,t,false));
+        }
+        std::vector<int>().swap(VertTile);
+        std::remove(facesFilename.c_str());
+
+        //TILE BY TILE REMESHING
+        //resolution and surface tolerance of the whole input, not of each tile
+        if (par.remesher.targetEdgeLen==0)
+            par.remesher.targetEdgeLen=AutoRemesher<MeshType>::ExpectedEdgeL(std::fabs(Volume),Area);
+        if (par.remesher.maxSurfDist==0)
+            par.remesher.maxSurfDist=box.Diag()/2500.;
+        for (size_t t=0;t<numTiles;t++)
+        {
+            std::vector<uint32_t> TileFaces;
+            {
+                const std::string tileFilename=TileFilename(par,t,false);
+                std::ifstream in=OpenIn(tileFilename);
+                in.seekg(0,std::ios::end);
+                TileFaces.resize(in.tellg()/sizeof(uint32_t));
+                in.seekg(0,std::ios::beg);
+                in.read(reinterpret_cast<char*>(TileFaces.data()),TileFaces.size()*sizeof(uint32_t));
+                if (!in)
+                    throw std::runtime_error("failed to read temporary file "+tileFilename);
+                in.close();
+                std::remove(tileFilename.c_str());
+            }
+
+            std::cout<<"Tile "<<t+1<<" of "<<numTiles<<": "<<TileFaces.size()/3<<" faces"<<std::endl;
+            std::unique_ptr<MeshType> tile(new MeshType());
+            BuildTile(TileFaces,Pos,par,*tile);
+            if (!AutoRemesher<MeshType>::RemeshTile(*tile,par.remesher,Cut))
+            {
+                std::cout<<"WARNING: the border of the tile changed, keeping it as it is"<<std::endl;
+                tile.reset(new MeshType());
+                BuildTile(TileFaces,Pos,par,*tile);
+            }
+            SaveTile(*tile,Cut,TileFilename(par,t,true));
+        }
+        std::vector<double>().swap(Pos);
+        std::vector<bool>().swap(Cut);
+
+        //STITCH ON THE SHARED VERTICES
+        mesh.Clear();
+        std::unordered_map<size_t,size_t> SharedToMesh;
+        for (size_t t=0;t<numTiles;t++)
+        {
+            const std::string tileFilename=TileFilename(par,t,true);
+            AppendTile(tileFilename,SharedToMesh,mesh);
+            std::remove(tileFilename.c_str());
+        }
+        std::cout<<"Out of core remeshing: stitched "<<mesh.fn<<" faces"<<std::endl;
+
+        //the cuts are no borders anymore, only the stitched mesh has the right features
+        MeshPrepocess<MeshType>::InitSharpFeatures(mesh,par.sharp_feature_thr,par.feature_erode_dilate);
+        return true;
+    }
+};
+
+#endif // OUT_OF_CORE_REMESHER_H
@@ -0,0 +1,281 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef STREAMING_MESH_READER_H
+#define STREAMING_MESH_READER_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//Reads the vertices and the faces of an .obj or .ply file in the order they are stored,
+//without building a mesh, so that inputs larger than the memory can be processed in passes.
+//Polygons are split in fans, everything but the positions and the face indices is skipped.
+class StreamingMeshReader
+{
+    enum PlyType {PTInt8,PTUInt8,PTInt16,PTUInt16,PTInt32,PTUInt32,PTFloat32,PTFloat64,PTUnknown};
+
+    struct PlyProperty
+    {
+        std::string name;
+        bool isList=false;
+        PlyType countType=PTUnknown;
+        PlyType type=PTUnknown;
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        size_t count=0;
+        std::vector<PlyProperty> props;
+    };
+
+    static PlyType ParsePlyType(const std::string &s)
+    {
+        if ((s=="char")||(s=="int8"))return PTInt8;
+        if ((s=="uchar")||(s=="uint8"))return PTUInt8;
+        if ((s=="short")||(s=="int16"))return PTInt16;
+        if ((s=="ushort")||(s=="uint16"))return PTUInt16;
+        if ((s=="int")||(s=="int32"))return PTInt32;
+        if ((s=="uint")||(s=="uint32"))return PTUInt32;
+        if ((s=="float")||(s=="float32"))return PTFloat32;
+        if ((s=="double")||(s=="float64"))return PTFloat64;
+        return PTUnknown;
+    }
+
+    static size_t PlyTypeSize(PlyType t)
+    {
+        switch (t)
+        {
+        case PTInt8: case PTUInt8: return 1;
+        case PTInt16: case PTUInt16: return 2;
+        case PTInt32: case PTUInt32: case PTFloat32: return 4;
+        case PTFloat64: return 8;
+        default: return 0;
+        }
+    }
+
+    template <class T>
+    static double Decode(const char *bytes,bool swap)
+    {
+        char buf[sizeof(T)];
+        std::memcpy(buf,bytes,sizeof(T));
+        if (swap)std::reverse(buf,buf+sizeof(T));
+        T val;
+        std::memcpy(&val,buf,sizeof(T));
+        return (double)val;
+    }
+
+    //one value of an ascii or binary ply body
+    static bool ReadPlyValue(std::istream &in,PlyType t,bool ascii,bool swap,double &val)
+    {
+        if (ascii)
+            return (bool)(in>>val);
+        char bytes[8];
+        if (!in.read(bytes,PlyTypeSize(t)))return false;
+        switch (t)
+        {
+        case PTInt8: val=Decode<int8_t>(bytes,swap); break;
+        case PTUInt8: val=Decode<uint8_t>(bytes,swap); break;
+        case PTInt16: val=Decode<int16_t>(bytes,swap); break;
+        case PTUInt16: val=Decode<uint16_t>(bytes,swap); break;
+        case PTInt32: val=Decode<int32_t>(bytes,swap); break;
+        case PTUInt32: val=Decode<uint32_t>(bytes,swap); break;
+        case PTFloat32: val=Decode<float>(bytes,swap); break;
+        case PTFloat64: val=Decode<double>(bytes,swap); break;
+        default: return false;
+        }
+        return true;
+    }
+
+    template <class FaceF>
+    static void EmitPolygon(const std::vector<size_t> &poly,FaceF &onFace)
+    {
+        for (size_t k=1;k+1<poly.size();k++)
+            onFace(poly[0],poly[k],poly[k+1]);
+    }
+
+    template <class VertexF,class FaceF>
+    static bool ReadOBJ(const std::string &filename,VertexF &onVertex,FaceF &onFace)
+    {
+        std::ifstream in(filename);
+        if (!in)return false;
+
+        size_t numVert=0;
+        std::string line;
+        std::vector<size_t> poly;
+        while (std::getline(in,line))
+        {
+            const char *c=line.c_str();
+            while ((*c==' ')||(*c=='\t'))c++;
+            if ((c[0]=='v')&&((c[1]==' ')||(c[1]=='\t')))
+            {
+                char *end;
+                double x=std::strtod(c+2,&end);
+                double y=std::strtod(end,&end);
+                double z=std::strtod(end,&end);
+                onVertex(x,y,z);
+                numVert++;
+                continue;
+            }
+            if ((c[0]!='f')||((c[1]!=' ')&&(c[1]!='\t')))continue;
+
+            poly.clear();
+            c+=2;
+            while (true)
+            {
+                char *end;
+                long index=std::strtol(c,&end,10);
+                if (end==c)break;
+                //1 based, negative values count back from the last vertex
+                if (index<0)index+=(long)numVert;
+                else index--;
+                if ((index<0)||(index>=(long)numVert))return false;
+                poly.push_back((size_t)index);
+                //skip texture and normal indices
+                c=end;
+                while ((*c!='\0')&&(*c!=' ')&&(*c!='\t'))c++;
+            }
+            EmitPolygon(poly,onFace);
+        }
+        return true;
+    }
+
+    template <class VertexF,class FaceF>
+    static bool ReadPLY(const std::string &filename,VertexF &onVertex,FaceF &onFace)
+    {
+        std::ifstream in(filename,std::ios::binary);
+        if (!in)return false;
+
+        std::string line;
+        if ((!std::getline(in,line))||(line.compare(0,3,"ply")!=0))return false;
+
+        bool ascii=false;
+        bool swap=false;
+        std::vector<PlyElement> elements;
+        while (std::getline(in,line))
+        {
+            if ((!line.empty())&&(line.back()=='\r'))line.pop_back();
+            std::istringstream ls(line);
+            std::string key;
+            ls>>key;
+            if (key=="end_header")break;
+            if (key=="format")
+            {
+                std::string format;
+                ls>>format;
+                ascii=(format=="ascii");
+                const bool bigEndian=(format=="binary_big_endian");
+                if ((!ascii)&&(!bigEndian)&&(format!="binary_little_endian"))return false;
+                swap=(!ascii)&&(bigEndian!=(std::endian::native==std::endian::big));
+            }
+            else if (key=="element")
+            {
+                PlyElement el;
+                ls>>el.name>>el.count;
+                elements.push_back(el);
+            }
+            else if (key=="property")
+            {
+                if (elements.empty())return false;
+                PlyProperty prop;
+                std::string type;
+                ls>>type;
+                if (type=="list")
+                {
+                    std::string countType;
+                    ls>>countType>>type;
+                    prop.isList=true;
+                    prop.countType=ParsePlyType(countType);
+                    if (prop.countType==PTUnknown)return false;
+                }
+                prop.type=ParsePlyType(type);
+                if (prop.type==PTUnknown)return false;
+                ls>>prop.name;
+                elements.back().props.push_back(prop);
+            }
+        }
+
+        std::vector<size_t> poly;
+        for (size_t e=0;e<elements.size();e++)
+        {
+            const PlyElement &el=elements[e];
+            const bool isVertex=(el.name=="vertex");
+            const bool isFace=(el.name=="face");
+            for (size_t i=0;i<el.count;i++)
+            {
+                double coord[3]={0,0,0};
+                poly.clear();
+                for (size_t p=0;p<el.props.size();p++)
+                {
+                    const PlyProperty &prop=el.props[p];
+                    double val;
+                    if (!prop.isList)
+                    {
+                        if (!ReadPlyValue(in,prop.type,ascii,swap,val))return false;
+                        if (isVertex&&(prop.name.size()==1)&&(prop.name[0]>='x')&&(prop.name[0]<='z'))
+                            coord[prop.name[0]-'x']=val;
+                        continue;
+                    }
+                    double count;
+                    if (!ReadPlyValue(in,prop.countType,ascii,swap,count))return false;
+                    const bool indices=isFace&&((prop.name=="vertex_indices")||(prop.name=="vertex_index"));
+                    for (size_t k=0;k<(size_t)count;k++)
+                    {
+                        if (!ReadPlyValue(in,prop.type,ascii,swap,val))return false;
+                        if (indices)poly.push_back((size_t)val);
+                    }
+                }
+                if (isVertex)
+                    onVertex(coord[0],coord[1],coord[2]);
+                if (isFace)
+                    EmitPolygon(poly,onFace);
+            }
+        }
+        return true;
+    }
+
+public:
+
+    //onVertex(x,y,z) for each vertex, onFace(v0,v1,v2) for each triangle with 0 based
+    //vertex indices. Returns false if the file cannot be opened or parsed.
+    template <class VertexF,class FaceF>
+    static bool Read(const std::string &filename,VertexF onVertex,FaceF onFace)
+    {
+        if (filename.find(".ply")!=std::string::npos)
+            return ReadPLY(filename,onVertex,onFace);
+        if (filename.find(".obj")!=std::string::npos)
+            return ReadOBJ(filename,onVertex,onFace);
+        return false;
+    }
+};
+
+#endif // STREAMING_MESH_READER_H
@@ -43,6 +43,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <vcg/complex/algorithms/attribute_seam.h>
 #include <vcg/complex/algorithms/crease_cut.h>
 #include "fields/field_smoother.h"
+#include "face_geometry.h"
+#include <sidecar.h>
 
 
 class FieldTriFace;
@@ -299,9 +301,25 @@ public:
         return false;
     }
 
-    bool SaveSharpFeatures(const std::string &filename)const
+    bool SaveSharpFeatures(const std::string &filename,bool binary=false)const
     {
         if(filename.empty()) return false;
+        if (binary)
+        {
+            std::vector<uint32_t> sharp;
+            for (size_t i=0;i<face.size();i++)
+                for (size_t j=0;j<3;j++)
+                {
+                    if (!face[i].IsFaceEdgeS(j))continue;
+                    sharp.push_back((face[i].FKind[j]==ETConcave)?0:1);
+                    sharp.push_back(sidecar::toIndex32(i));
+                    sharp.push_back(sidecar::toIndex32(j));
+                }
+            sidecar::Writer writer(sidecar::Kind::Sharp);
+            writer.addArray(sharp);
+            writer.save(filename);
+            return true;
+        }
         std::ofstream myfile;
         myfile.open (filename.c_str());
         size_t num=0;
@@ -339,6 +357,19 @@ public:
             vcg::tri::CrossField<FieldTriMesh>::UpdateSingularByCross(*this,true);
             return true;
         }
+        if ((position1!=-1)&&(sidecar::isBinary(field_filename)))
+        {
+            std::cout<<"Importing binary ROSY field"<<std::endl;
+            bool loaded=sidecar::loadField(field_filename,face.size(),[&](size_t IndexF,const double *PD1,const double *PD2)
+            {
+                face[IndexF].PD1()=CoordType(PD1[0],PD1[1],PD1[2]);
+                face[IndexF].PD2()=CoordType(PD2[0],PD2[1],PD2[2]);
+            });
+            if (!loaded)return false;
+            vcg::tri::CrossField<FieldTriMesh>::OrientDirectionFaceCoherently(*this);
+            vcg::tri::CrossField<FieldTriMesh>::UpdateSingularByCross(*this,true);
+            return true;
+        }
         if (position1!=-1)
         {
             std::cout<<"Importing ROSY field"<<std::endl;
@@ -364,6 +395,14 @@ public:
             }
         }
 
+        if (sidecar::isBinary(filename))
+        {
+            return sidecar::loadSharp(filename,face.size(),[&](int TypeSh,size_t IndexF,size_t IndexE)
+            {
+                SetSharpEdge(IndexF,IndexE,TypeSh);
+            });
+        }
+
         FILE *f=fopen(filename.c_str(),"rt");
         if (f==NULL)return false;
         int Num;
@@ -373,31 +412,37 @@ public:
         {
             int TypeSh,IndexF,IndexE;
             fscanf(f,"%d,%d,%d,/n",&TypeSh,&IndexF,&IndexE);
-            assert((TypeSh==0)||(TypeSh==1));
-            assert((IndexE>=0)&&(IndexE<3));
-            assert((IndexF>=0)&&(IndexF<face.size()));
-            if (TypeSh==0)
-                face[IndexF].FKind[IndexE]=ETConcave;
-            else
-                face[IndexF].FKind[IndexE]=ETConvex;
-
-            face[IndexF].SetFaceEdgeS(IndexE);
-
-            if (!vcg::face::IsBorder(face[IndexF],IndexE))
-            {
-                FaceType *Fopp=face[IndexF].FFp(IndexE);
-                int IOpp=face[IndexF].FFi(IndexE);
-                Fopp->SetFaceEdgeS(IOpp);
-                if (TypeSh==0)
-                    Fopp->FKind[IOpp]=ETConcave;
-                else
-                    Fopp->FKind[IOpp]=ETConvex;
-            }
+            SetSharpEdge(IndexF,IndexE,TypeSh);
         }
         fclose(f);
         return true;
     }
 
+    //mark the edge and its opposite as sharp, TypeSh 0 is concave, 1 convex
+    void SetSharpEdge(size_t IndexF,size_t IndexE,int TypeSh)
+    {
+        assert((TypeSh==0)||(TypeSh==1));
+        assert((IndexE>=0)&&(IndexE<3));
+        assert((IndexF>=0)&&(IndexF<face.size()));
+        if (TypeSh==0)
+            face[IndexF].FKind[IndexE]=ETConcave;
+        else
+            face[IndexF].FKind[IndexE]=ETConvex;
+
+        face[IndexF].SetFaceEdgeS(IndexE);
+
+        if (!vcg::face::IsBorder(face[IndexF],IndexE))
+        {
+            FaceType *Fopp=face[IndexF].FFp(IndexE);
+            int IOpp=face[IndexF].FFi(IndexE);
+            Fopp->SetFaceEdgeS(IOpp);
+            if (TypeSh==0)
+                Fopp->FKind[IOpp]=ETConcave;
+            else
+                Fopp->FKind[IOpp]=ETConvex;
+        }
+    }
+
     bool LoadSharpFeaturesFL(const std::string &filename)
     {
         std::cout<<"Loading Sharp Features FL Format"<<std::endl;
@@ -513,9 +558,26 @@ public:
         return true;
     }
 
-    bool SaveField(const std::string &filename)
+    bool SaveField(const std::string &filename,bool binary=false)
     {
         if(filename.empty()) return false;
+        if (binary)
+        {
+            std::vector<double> PD1,PD2;
+            PD1.reserve(3*face.size());
+            PD2.reserve(3*face.size());
+            for (size_t i=0;i<face.size();i++)
+                for (size_t j=0;j<3;j++)
+                {
+                    PD1.push_back(face[i].cPD1()[j]);
+                    PD2.push_back(face[i].cPD2()[j]);
+                }
+            sidecar::Writer writer(sidecar::Kind::Field);
+            writer.addArray(PD1);
+            writer.addArray(PD2);
+            writer.save(filename);
+            return true;
+        }
         vcg::tri::io::ExporterFIELD<FieldTriMesh>::Save4ROSY(*this,filename.c_str());
         return true;
     }
@@ -545,7 +607,22 @@ public:
                 face[i].ClearFaceEdgeS(j);
 
         if (SharpAngleDegree>0)
-            vcg::tri::UpdateFlags<MeshType>::FaceEdgeSelCrease(*this,vcg::math::ToRad(SharpAngleDegree));
+        {
+            //same selection as UpdateFlags::FaceEdgeSelCrease, on the dihedral cosines
+            vcg::tri::FaceGeometry<FieldTriMesh>::Snapshot S;
+            vcg::tri::FaceGeometry<FieldTriMesh>::ArrayX N[3],D[3];
+            vcg::tri::FaceGeometry<FieldTriMesh>::Update(*this,S,1,true);
+            vcg::tri::FaceGeometry<FieldTriMesh>::Normals(S,N);
+            vcg::tri::FaceGeometry<FieldTriMesh>::NormalDots(S,N,D);
+            const ScalarType cosThr=cos(vcg::math::ToRad(SharpAngleDegree));
+            for (size_t i=0;i<face.size();i++)
+            {
+                if (face[i].IsD())continue;
+                for (size_t j=0;j<3;j++)
+                    if (D[j][i]<cosThr)
+                        face[i].SetFaceEdgeS(j);
+            }
+        }
         InitEdgeType();
 
         for (size_t i=0;i<face.size();i++)
@@ -28,9 +28,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <fstream>
 #include <algorithm>
 #include "assert.h"
+#include <sidecar.h>
 
 std::vector<std::vector<size_t>> loadPatches(const std::string& filename)
 {
+    if (sidecar::isBinary(filename))
+        return sidecar::loadPatches(filename);
+
     std::vector<std::vector<size_t>> partitions;
 
     std::ifstream input;
@@ -70,6 +74,9 @@ std::vector<std::vector<size_t>> loadPatches(const std::string& filename)
 
 std::vector<std::vector<size_t>> loadCorners(const std::string& filename)
 {
+    if (sidecar::isBinary(filename))
+        return sidecar::loadCorners(filename);
+
     std::vector<std::vector<size_t>> corners;
 
     std::ifstream input;
@@ -111,6 +118,9 @@ std::vector<std::vector<size_t>> loadCorners(const std::string& filename)
 
 std::vector<std::pair<size_t,size_t> > LoadFeatures(const std::string &filename)
 {
+    if (sidecar::isBinary(filename))
+        return sidecar::loadFeatures(filename);
+
     std::vector<std::pair<size_t,size_t> > features;
     FILE *f=NULL;
     f=fopen(filename.c_str(),"rt");
@@ -137,6 +147,9 @@ std::vector<std::pair<size_t,size_t> > LoadFeatures(const std::string &filename)
 
 std::vector<size_t> loadFeatureCorners(const std::string &filename)
 {
+    if (sidecar::isBinary(filename))
+        return sidecar::loadFeatureCorners(filename);
+
     std::vector<size_t> featureCorners;
     FILE *f=NULL;
     f=fopen(filename.c_str(),"rt");
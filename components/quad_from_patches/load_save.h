@@ -28,6 +28,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <string>
 #include <vector>
+
+// Each loader accepts the text format as well as the binary sidecar format.
 std::vector<std::vector<size_t>> loadPatches(const std::string& filename);
 std::vector<std::vector<size_t>> loadCorners(const std::string& filename);
 std::vector<std::pair<size_t,size_t>> LoadFeatures(const std::string &filename);
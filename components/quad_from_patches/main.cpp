@@ -52,6 +52,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <quadretopology/qr_eval_quantization_json.h>
 
 #include <iostream>
+#include <sstream>
+#include <mutex>
 
 #ifdef _WIN32
 #  include <windows.h>
@@ -64,8 +66,8 @@ using Timekeeper::ScopedStopWatch;
 
 bool LocalUVSm=false;
 typename TriangleMesh::ScalarType avgEdge(const TriangleMesh& trimesh);
-void loadSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, float& scaleFactor, int& fixedChartClusters);
-void SaveSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, float& scaleFactor, int& fixedChartClusters);
+void loadSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, std::vector<float>& scaleFactors, int& fixedChartClusters);
+void SaveSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, std::vector<float>& scaleFactors, int& fixedChartClusters);
 //int FindCurrentNum(std::string &pathProject);
 
 int actual_main(int argc, char *argv[])
@@ -136,11 +138,11 @@ int actual_main(int argc, char *argv[])
         json_filename = argv[4];
     }
     QuadRetopology::Parameters parameters;
-    float scaleFactor;
+    std::vector<float> scaleFactors;
     int fixedChartClusters;
 
     sw_load.resume();
-    loadSetupFile(configFilename, parameters, scaleFactor, fixedChartClusters);
+    loadSetupFile(configFilename, parameters, scaleFactors, fixedChartClusters);
 
     parameters.chartSmoothingIterations = 0; //Chart smoothing
     parameters.quadrangulationFixedSmoothingIterations = 0; //Smoothing with fixed borders of the patches
@@ -201,81 +203,146 @@ int actual_main(int argc, char *argv[])
 
     //COMPUTE QUADRANGULATION
     QuadRetopology::internal::updateAllMeshAttributes(trimesh);
-    double EdgeSize=avgEdge(trimesh)*scaleFactor;
-    std::cout<<"Edge Size "<<EdgeSize<<std::endl;
-    const std::vector<double> edgeFactor(trimeshPartitions.size(), EdgeSize);
-    auto qfp_result = qfp::quadrangulationFromPatches(trimesh, trimeshPartitions, trimeshCorners, edgeFactor, parameters, fixedChartClusters, quadmesh, quadmeshPartitions, quadmeshCorners, ilpResult);
-
+    const double avgEdgeLength=avgEdge(trimesh);
+    std::vector<double> edgeSizes;
+    std::vector<std::vector<double>> edgeFactors;
+    for (float scaleFactor : scaleFactors) {
+        edgeSizes.push_back(avgEdgeLength*scaleFactor);
+        edgeFactors.emplace_back(trimeshPartitions.size(), edgeSizes.back());
+        std::cout<<"Edge Size "<<edgeSizes.back()<<std::endl;
+    }
 
+    std::vector<size_t> TriPart(trimesh.face.size(),0);
+    for (size_t i=0;i<trimeshPartitions.size();i++)
+        for (size_t j=0;j<trimeshPartitions[i].size();j++)
+            TriPart[trimeshPartitions[i][j]]=i;
 
-    //COLOR AND SAVE QUADRANGULATION
-    vcg::tri::UpdateColor<PolyMesh>::PerFaceConstant(quadmesh);
-    for(size_t i = 0; i < quadmeshPartitions.size(); i++)
+    //Smoothing marks the faces of trimesh, so with several densities the
+    //outputs are colored, smoothed and saved one at a time
+    std::mutex outputMutex;
+    auto saveQuadrangulation = [&](
+            const std::string& suffix,
+            PolyMesh& quadmesh,
+            const std::vector<std::vector<size_t>>& quadmeshPartitions,
+            const std::vector<std::vector<size_t>>& quadmeshCorners,
+            const double EdgeSize)
     {
-        vcg::Color4b partitionColor = vcg::Color4b::Scatter(static_cast<int>(quadmeshPartitions.size()), static_cast<int>(i));
-        for(size_t j = 0; j < quadmeshPartitions[i].size(); j++)
+        std::lock_guard<std::mutex> lock(outputMutex);
+
+        //COLOR AND SAVE QUADRANGULATION
+        vcg::tri::UpdateColor<PolyMesh>::PerFaceConstant(quadmesh);
+        for(size_t i = 0; i < quadmeshPartitions.size(); i++)
         {
-            size_t fId = quadmeshPartitions[i][j];
-            quadmesh.face[fId].C() = partitionColor;
+            vcg::Color4b partitionColor = vcg::Color4b::Scatter(static_cast<int>(quadmeshPartitions.size()), static_cast<int>(i));
+            for(size_t j = 0; j < quadmeshPartitions[i].size(); j++)
+            {
+                size_t fId = quadmeshPartitions[i][j];
+                quadmesh.face[fId].C() = partitionColor;
+            }
         }
-    }
 
-//    size_t CurrNum=FindCurrentNum(meshFilename);
+        sw_save.resume();
+        //SAVE OUTPUT
+        std::string outputFilename = meshFilename;
+        outputFilename.erase(partitionFilename.find_last_of("."));
+        outputFilename+=std::string("_")+std::to_string(CurrNum)+std::string("_quadrangulation")+suffix+std::string(".obj");
+        vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(), vcg::tri::io::Mask::IOM_FACECOLOR);
 
-    sw_save.resume();
-    //SAVE OUTPUT
-    std::string outputFilename = meshFilename;
-    outputFilename.erase(partitionFilename.find_last_of("."));
-    outputFilename+=std::string("_")+std::to_string(CurrNum)+std::string("_quadrangulation")+std::string(".obj");
-    vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(), vcg::tri::io::Mask::IOM_FACECOLOR);
-
-    sw_save.stop();
+        sw_save.stop();
 
-//    ReMapBoundaries(trimesh,quadmesh,trimeshCorners,trimeshPartitions,
-//                    quadmeshCorners,quadmeshPartitions);
+//        ReMapBoundaries(trimesh,quadmesh,trimeshCorners,trimeshPartitions,
+//                        quadmeshCorners,quadmeshPartitions);
 
 
 #define SMOOTH_OUTPUT
 #ifdef SMOOTH_OUTPUT
 
-    sw_smooth.resume();
-    //SMOOTH
-    std::vector<size_t> QuadPart(quadmesh.face.size(),0);
-    for (size_t i=0;i<quadmeshPartitions.size();i++)
-        for (size_t j=0;j<quadmeshPartitions[i].size();j++)
-            QuadPart[quadmeshPartitions[i][j]]=i;
-
-    std::vector<size_t> TriPart(trimesh.face.size(),0);
-    for (size_t i=0;i<trimeshPartitions.size();i++)
-        for (size_t j=0;j<trimeshPartitions[i].size();j++)
-            TriPart[trimeshPartitions[i][j]]=i;
-
-    std::vector<size_t> QuadCornersVect;
-    for (size_t i=0;i<quadmeshCorners.size();i++)
-        for (size_t j=0;j<quadmeshCorners[i].size();j++)
-            QuadCornersVect.push_back(quadmeshCorners[i][j]);
-    std::sort(QuadCornersVect.begin(),QuadCornersVect.end());
-    auto last=std::unique(QuadCornersVect.begin(),QuadCornersVect.end());
-    QuadCornersVect.erase(last, QuadCornersVect.end());
-
-    std::cout<<"** SMOOTHING **"<<std::endl;
-    //SmoothSubdivide(trimesh,quadmesh,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,100,0.5,EdgeSize);
-    if (LocalUVSm)
-        LocalUVSmooth(quadmesh,trimesh,trimeshFeatures,trimeshFeaturesC,30);
-    else
-        MultiCostraintSmooth(quadmesh,trimesh,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,0.5,EdgeSize,30,1);
+        sw_smooth.resume();
+        //SMOOTH
+        std::vector<size_t> QuadPart(quadmesh.face.size(),0);
+        for (size_t i=0;i<quadmeshPartitions.size();i++)
+            for (size_t j=0;j<quadmeshPartitions[i].size();j++)
+                QuadPart[quadmeshPartitions[i][j]]=i;
+
+        std::vector<size_t> QuadCornersVect;
+        for (size_t i=0;i<quadmeshCorners.size();i++)
+            for (size_t j=0;j<quadmeshCorners[i].size();j++)
+                QuadCornersVect.push_back(quadmeshCorners[i][j]);
+        std::sort(QuadCornersVect.begin(),QuadCornersVect.end());
+        auto last=std::unique(QuadCornersVect.begin(),QuadCornersVect.end());
+        QuadCornersVect.erase(last, QuadCornersVect.end());
+
+        std::cout<<"** SMOOTHING **"<<std::endl;
+        //SmoothSubdivide(trimesh,quadmesh,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,100,0.5,EdgeSize);
+        if (LocalUVSm)
+            LocalUVSmooth(quadmesh,trimesh,trimeshFeatures,trimeshFeaturesC,30);
+        else
+            MultiCostraintSmooth(quadmesh,trimesh,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,0.5,EdgeSize,30,1);
+
+        sw_smooth.stop();
+        sw_save.resume();
+        //SAVE OUTPUT
+        outputFilename = meshFilename;
+        outputFilename.erase(partitionFilename.find_last_of("."));
+        //outputFilename.append("_quadrangulation_smooth.obj");
+        outputFilename+=std::string("_")+std::to_string(CurrNum)+std::string("_quadrangulation_smooth")+suffix+std::string(".obj");
+
+        vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(), vcg::tri::io::Mask::IOM_FACECOLOR);
+        sw_save.stop();
+#endif
+    };
+
+    auto resultJson = [](const qfp::QuadrangulationResult& qfp_result) {
+        auto json = nlohmann::json{
+          {"quant_eval", qfp_result.eval}};
+        if (!qfp_result.bimdf_results.empty()) {
+            json["bimdf_results"] = qfp_result.bimdf_results;
+            json["flow_solvers"] = qfp_result.flow_solvers;
+        }
+        if (!qfp_result.flow_stats.empty()) {
+            json["flow_stats"] = qfp_result.flow_stats;
+        }
+        if (!qfp_result.ilp_stats_per_cluster.empty()) {
+            json["ilp_stats_per_cluster"] = qfp_result.ilp_stats_per_cluster;
+        }
+        return json;
+    };
+
+    if (scaleFactors.size() > 1) {
+        //One quadrangulation per scale factor, saved as *_quadrangulation_s<k>.obj
+        auto qfp_result = qfp::quadrangulationsFromPatches<PolyMesh>(
+                trimesh, trimeshPartitions, trimeshCorners, edgeFactors, parameters, fixedChartClusters,
+                [&](const size_t k,
+                    PolyMesh& quadmesh,
+                    const std::vector<std::vector<size_t>>& quadmeshPartitions,
+                    const std::vector<std::vector<size_t>>& quadmeshCorners,
+                    const std::vector<int>&)
+        {
+            saveQuadrangulation("_s" + std::to_string(k), quadmesh, quadmeshPartitions, quadmeshCorners, edgeSizes[k]);
+        });
+
+        sw_root.stop();
+        auto sw_result = Timekeeper::HierarchicalStopWatchResult(sw_root);
+        sw_result.add_child(qfp_result.stopwatch);
+        std::cout << "\n" << sw_result << std::endl;
+        auto json = nlohmann::json{
+          {"runtimes", sw_result},
+          {"densities", nlohmann::json::array()}};
+        for (size_t k = 0; k < qfp_result.densities.size(); ++k) {
+            auto density_json = resultJson(qfp_result.densities[k]);
+            density_json["scale_factor"] = scaleFactors[k];
+            json["densities"].push_back(std::move(density_json));
+        }
+        if (!json_filename.empty()) {
+          std::ofstream json_file{json_filename};
+          json_file << std::setw(4) << json;
+        }
+        return 0;
+    }
 
-    sw_smooth.stop();
-    sw_save.resume();
-    //SAVE OUTPUT
-    outputFilename = meshFilename;
-    outputFilename.erase(partitionFilename.find_last_of("."));
-    //outputFilename.append("_quadrangulation_smooth.obj");
-    outputFilename+=std::string("_")+std::to_string(CurrNum)+std::string("_quadrangulation_smooth")+std::string(".obj");
+    auto qfp_result = qfp::quadrangulationFromPatches(trimesh, trimeshPartitions, trimeshCorners, edgeFactors[0], parameters, fixedChartClusters, quadmesh, quadmeshPartitions, quadmeshCorners, ilpResult);
 
-    vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(), vcg::tri::io::Mask::IOM_FACECOLOR);
-    sw_save.stop();
-#endif
+    saveQuadrangulation("", quadmesh, quadmeshPartitions, quadmeshCorners, edgeSizes[0]);
 
 #ifdef SAVE_MESHES_FOR_DEBUG
     sw_save.start();
@@ -303,25 +370,15 @@ int actual_main(int argc, char *argv[])
    //setupFilename.append("_quadrangulation_setup.txt");
    setupFilename+=std::string("_")+std::to_string(CurrNum)+std::string("_quadrangulation_setup")+std::string(".txt");
 
-   SaveSetupFile(setupFilename, parameters, scaleFactor, fixedChartClusters);
+   SaveSetupFile(setupFilename, parameters, scaleFactors, fixedChartClusters);
     sw_save.stop();
  #endif
     sw_root.stop();
     auto sw_result = Timekeeper::HierarchicalStopWatchResult(sw_root);
     sw_result.add_child(qfp_result.stopwatch);
     std::cout << "\n" << sw_result << std::endl;
-    auto json = nlohmann::json{
-      {"runtimes", sw_result},
-      {"quant_eval", qfp_result.eval}};
-    if (!qfp_result.bimdf_results.empty()) {
-        json["bimdf_results"] = qfp_result.bimdf_results;
-    }
-    if (!qfp_result.flow_stats.empty()) {
-        json["flow_stats"] = qfp_result.flow_stats;
-    }
-    if (!qfp_result.ilp_stats_per_cluster.empty()) {
-        json["ilp_stats_per_cluster"] = qfp_result.ilp_stats_per_cluster;
-    }
+    auto json = resultJson(qfp_result);
+    json["runtimes"] = sw_result;
     if (!json_filename.empty()) {
       std::ofstream json_file{json_filename};
       json_file << std::setw(4) << json;
@@ -343,7 +400,7 @@ typename TriangleMesh::ScalarType avgEdge(const TriangleMesh& trimesh)
     return (AvgVal/Num);
 }
 
-void loadSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, float& scaleFactor, int& fixedChartClusters)
+void loadSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, std::vector<float>& scaleFactors, int& fixedChartClusters)
 {
     FILE *f=fopen(path.c_str(),"rt");
     if (f == nullptr) {
@@ -458,7 +515,18 @@ void loadSetupFile(const std::string& path, QuadRetopology::Parameters& paramete
     else
         parameters.hardParityConstraint=true;
 
-    fscanf(f,"scaleFact %f\n",&scaleFactor);
+    //one or more scale factors, each one gives a separate quadrangulation
+    std::array<char, 1024> scaleFactorList = {0};
+    fscanf(f,"scaleFact %1000[^\n]\n",scaleFactorList.data());
+    std::istringstream scaleFactorStream(scaleFactorList.data());
+    scaleFactors.clear();
+    for (float scaleFactor; scaleFactorStream >> scaleFactor;) {
+        scaleFactors.push_back(scaleFactor);
+    }
+    if (scaleFactors.empty()) {
+        fclose(f);
+        throw std::runtime_error(std::string("no scaleFact in setup file ") + path);
+    }
     
     fscanf(f,"fixedChartClusters %d\n",&fixedChartClusters);
     fscanf(f,"useFlowSolver %d\n",&IntVar);
@@ -476,10 +544,26 @@ void loadSetupFile(const std::string& path, QuadRetopology::Parameters& paramete
     ret = fscanf(f,"satsuma_config_filename \"%1000[^\"]\"\n",filename.data());
     parameters.satsuma_config_filename = filename.data();
     std::cout << "satsuma_config_filename: " << parameters.satsuma_config_filename << std::endl;
+
+    //optional
+    ret = fscanf(f,"numThreads %d\n",&parameters.numThreads);
+    std::cout << "numThreads: " << parameters.numThreads << std::endl;
+
+    IntVar = parameters.patternCache;
+    ret = fscanf(f,"patternCache %d\n",&IntVar);
+    parameters.patternCache = IntVar;
+
+    std::fill(filename.begin(), filename.end(), 0);
+    ret = fscanf(f,"patternCacheFilename \"%1000[^\"]\"\n",filename.data());
+    parameters.patternCacheFilename = filename.data();
+    //a cache file turns the cache on
+    if (!parameters.patternCacheFilename.empty())
+        parameters.patternCache = true;
+    std::cout << "patternCache: " << parameters.patternCache << std::endl;
     fclose(f);
 }
 
-void SaveSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, float& scaleFactor, int& fixedChartClusters)
+void SaveSetupFile(const std::string& path, QuadRetopology::Parameters& parameters, std::vector<float>& scaleFactors, int& fixedChartClusters)
 {
     FILE *f=fopen(path.c_str(),"wt");
     assert(f!=NULL);
@@ -556,7 +640,11 @@ void SaveSetupFile(const std::string& path, QuadRetopology::Parameters& paramete
     else
         fprintf(f,"hardParityConstraint 0\n");
 
-    fprintf(f,"scaleFact %f\n", static_cast<float>(scaleFactor));
+    fprintf(f,"scaleFact");
+    for (float& scaleFactor : scaleFactors) {
+        fprintf(f," %f", scaleFactor);
+    }
+    fprintf(f,"\n");
 
     fprintf(f,"fixedChartClusters %d\n", fixedChartClusters);
 
@@ -26,7 +26,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "quad_from_patches.h"
 #include <quadretopology/quadretopology.h>
 #include <quadretopology/qr_eval_quantization.h>
+#include <quadretopology/includes/qr_parallel.h>
+#include <quadretopology/includes/qr_patterns.h>
 #include <random>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
 
 #ifdef SAVE_MESHES_FOR_DEBUG
 #include <igl/writeOBJ.h>
@@ -36,42 +42,36 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace qfp {
 
+namespace internal {
+
+//Quantize and quadrangulate the charts of chartData, sw_root is running and
+//is stopped before returning
 template<class PolyMesh, class TriangleMesh>
 QuadrangulationResult
-quadrangulationFromPatches(
+quadrangulationFromChartData(
     TriangleMesh& trimesh,
-    const std::vector<std::vector<size_t>>& trimeshPartitions,
-    const std::vector<std::vector<size_t>>& trimeshCorners,
+    const QuadRetopology::ChartData& chartData,
     const std::vector<double>& chartEdgeLength,
     const QuadRetopology::Parameters& parameters,
     const int fixedChartClusters,
+    QuadRetopology::FlowSession* flowSession,
     PolyMesh& quadmesh,
     std::vector<std::vector<size_t>>& quadmeshPartitions,
     std::vector<std::vector<size_t>>& quadmeshCorners,
-    std::vector<int>& ilpResult)
+    std::vector<int>& ilpResult,
+    Timekeeper::HierarchicalStopWatch& sw_root)
 {
     using HSW = Timekeeper::HierarchicalStopWatch;
-    HSW sw_root{"qfp"};
     HSW sw_quadrangulate("quadrangulate", sw_root);
-    HSW sw_compute_chart_data("compute_chart_data", sw_root);
 
     std::vector<Satsuma::BiMDFFullResult> bimdf_results; // empty if ILP was used
+    std::vector<std::string> flow_solvers;
     std::vector<QuadRetopology::FlowStats> flow_stats;
     std::vector<std::vector<QuadRetopology::ILPStats>> ilp_stats_per_cluster;
 
-    sw_root.resume();
     std::vector<Timekeeper::HierarchicalStopWatchResult> sw_results;
 
-    assert(trimeshPartitions.size() == trimeshCorners.size() && chartEdgeLength.size() == trimeshPartitions.size());
-
-
-    //Get chart data
-    sw_compute_chart_data.resume();
-    QuadRetopology::ChartData chartData = QuadRetopology::computeChartData(
-            trimesh,
-            trimeshPartitions,
-            trimeshCorners);
-    sw_compute_chart_data.stop();
+    assert(chartEdgeLength.size() == chartData.charts.size());
 
 
     //Initialize ilp results
@@ -221,7 +221,7 @@ quadrangulationFromPatches(
                         edgeLength /= numIncident;
 
                         double sideSubdivision = subside.length / edgeLength;
-                        if (!parameters.hardParityConstraint) {
+                        if (!parameters.useFlowSolver && !parameters.hardParityConstraint) {
                             sideSubdivision /= 2.0;
                         }
 
@@ -244,50 +244,69 @@ quadrangulationFromPatches(
 
 
 
-            for (int clusterId = 0; clusterId < lastClusterId; ++clusterId) {
-                int numInCluster = 0;
+            if (parameters.useFlowSolver) {
+                //The clusters are independent once the subsides between them are fixed:
+                //the flow solver splits them into components and solves them concurrently
+                solvedCluster = true;
+                double gap;
+                auto subdiv_res = QuadRetopology::findSubdivisions(
+                    chartData,
+                    chartEdgeLength,
+                    parameters,
+                    gap,
+                    ilpResult,
+                    flowSession);
+                bimdf_results = std::move(subdiv_res.bimdf_results);
+                flow_solvers = std::move(subdiv_res.flow_solvers);
+                flow_stats = std::move(subdiv_res.flow_stats);
+                sw_results.push_back(std::move(subdiv_res.stopwatch));
+            }
+            else {
+                for (int clusterId = 0; clusterId < lastClusterId; ++clusterId) {
+                    int numInCluster = 0;
 
-                std::vector<int> result(chartData.subsides.size(), ILP_IGNORE);
-                for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
-                    if (ilpResult[subsideId] >= 0) {
-                        result[subsideId] = ilpResult[subsideId];
+                    std::vector<int> result(chartData.subsides.size(), ILP_IGNORE);
+                    for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
+                        if (ilpResult[subsideId] >= 0) {
+                            result[subsideId] = ilpResult[subsideId];
+                        }
                     }
-                }
 
-                for (size_t cId = 0; cId < chartData.charts.size(); ++cId) {
-                    if (chartCluster[cId] == clusterId) {
-                        numInCluster++;
+                    for (size_t cId = 0; cId < chartData.charts.size(); ++cId) {
+                        if (chartCluster[cId] == clusterId) {
+                            numInCluster++;
+                        }
                     }
-                }
 
-                if (numInCluster > 0) {
-                    solvedCluster = true;
-                    for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
-                        std::array<int, 2> incidentCharts = chartData.subsides[subsideId].incidentCharts;
+                    if (numInCluster > 0) {
+                        solvedCluster = true;
+                        for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
+                            std::array<int, 2> incidentCharts = chartData.subsides[subsideId].incidentCharts;
 
-                        if ((incidentCharts[0] == -1 || chartCluster[incidentCharts[0]] == clusterId) && (incidentCharts[1] == -1 || chartCluster[incidentCharts[1]] == clusterId)) {
-                            result[subsideId] = ILP_FIND_SUBDIVISION;
+                            if ((incidentCharts[0] == -1 || chartCluster[incidentCharts[0]] == clusterId) && (incidentCharts[1] == -1 || chartCluster[incidentCharts[1]] == clusterId)) {
+                                result[subsideId] = ILP_FIND_SUBDIVISION;
+                            }
                         }
-                    }
 
-                    double gap;
-                    {
-                      auto subdiv_res = QuadRetopology::findSubdivisions(
-                          chartData,
-                          chartEdgeLength,
-                          parameters,
-                          gap,
-                          result);
-                      sw_results.push_back(std::move(subdiv_res.stopwatch));
-                      assert(subdiv_res.bimdf_results.empty()); // Flow does not work on clusters
-                      if (!subdiv_res.ilp_stats.empty()) {
-                          ilp_stats_per_cluster.push_back(std::move(subdiv_res.ilp_stats));
-                      }
-                    }
+                        double gap;
+                        {
+                          auto subdiv_res = QuadRetopology::findSubdivisions(
+                              chartData,
+                              chartEdgeLength,
+                              parameters,
+                              gap,
+                              result);
+                          sw_results.push_back(std::move(subdiv_res.stopwatch));
+                          assert(subdiv_res.bimdf_results.empty()); // Flow does not work on clusters
+                          if (!subdiv_res.ilp_stats.empty()) {
+                              ilp_stats_per_cluster.push_back(std::move(subdiv_res.ilp_stats));
+                          }
+                        }
 
-                    for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
-                        if (result[subsideId] != ILP_IGNORE && ilpResult[subsideId] == ILP_FIND_SUBDIVISION) {
-                            ilpResult[subsideId] = result[subsideId];
+                        for (size_t subsideId = 0; subsideId < chartData.subsides.size(); subsideId++) {
+                            if (result[subsideId] != ILP_IGNORE && ilpResult[subsideId] == ILP_FIND_SUBDIVISION) {
+                                ilpResult[subsideId] = result[subsideId];
+                            }
                         }
                     }
                 }
@@ -304,8 +323,10 @@ quadrangulationFromPatches(
               chartEdgeLength,
               parameters,
               gap,
-              ilpResult);
+              ilpResult,
+              flowSession);
           bimdf_results = std::move(subdiv_res.bimdf_results);
+          flow_solvers = std::move(subdiv_res.flow_solvers);
           flow_stats = std::move(subdiv_res.flow_stats);
           if (!subdiv_res.ilp_stats.empty()) {
               ilp_stats_per_cluster.push_back({std::move(subdiv_res.ilp_stats)});
@@ -341,6 +362,7 @@ quadrangulationFromPatches(
     }
     return {
         .bimdf_results = std::move(bimdf_results),
+        .flow_solvers = std::move(flow_solvers),
         .flow_stats = std::move(flow_stats),
         .ilp_stats_per_cluster = std::move(ilp_stats_per_cluster),
         .eval = std::move(quant_eval),
@@ -348,3 +370,162 @@ quadrangulationFromPatches(
 }
 
 }
+
+template<class PolyMesh, class TriangleMesh>
+QuadrangulationResult
+quadrangulationFromPatches(
+    TriangleMesh& trimesh,
+    const std::vector<std::vector<size_t>>& trimeshPartitions,
+    const std::vector<std::vector<size_t>>& trimeshCorners,
+    const std::vector<double>& chartEdgeLength,
+    const QuadRetopology::Parameters& parameters,
+    const int fixedChartClusters,
+    PolyMesh& quadmesh,
+    std::vector<std::vector<size_t>>& quadmeshPartitions,
+    std::vector<std::vector<size_t>>& quadmeshCorners,
+    std::vector<int>& ilpResult)
+{
+    using HSW = Timekeeper::HierarchicalStopWatch;
+    HSW sw_root{"qfp"};
+    HSW sw_compute_chart_data("compute_chart_data", sw_root);
+
+    sw_root.resume();
+
+    assert(trimeshPartitions.size() == trimeshCorners.size() && chartEdgeLength.size() == trimeshPartitions.size());
+
+
+    //Get chart data
+    sw_compute_chart_data.resume();
+    QuadRetopology::ChartData chartData = QuadRetopology::computeChartData(
+            trimesh,
+            trimeshPartitions,
+            trimeshCorners);
+    sw_compute_chart_data.stop();
+
+    return internal::quadrangulationFromChartData(
+            trimesh,
+            chartData,
+            chartEdgeLength,
+            parameters,
+            fixedChartClusters,
+            nullptr,
+            quadmesh,
+            quadmeshPartitions,
+            quadmeshCorners,
+            ilpResult,
+            sw_root);
+}
+
+template<class PolyMesh, class TriangleMesh, class F>
+MultiDensityResult
+quadrangulationsFromPatches(
+    TriangleMesh& trimesh,
+    const std::vector<std::vector<size_t>>& trimeshPartitions,
+    const std::vector<std::vector<size_t>>& trimeshCorners,
+    const std::vector<std::vector<double>>& chartEdgeLengths,
+    const QuadRetopology::Parameters& parameters,
+    const int fixedChartClusters,
+    const F& onQuadrangulation)
+{
+    using HSW = Timekeeper::HierarchicalStopWatch;
+    HSW sw_root{"qfp"};
+    HSW sw_compute_chart_data("compute_chart_data", sw_root);
+
+    sw_root.resume();
+
+    const size_t numDensities = chartEdgeLengths.size();
+    for (const std::vector<double>& chartEdgeLength : chartEdgeLengths) {
+        assert(trimeshPartitions.size() == trimeshCorners.size() && chartEdgeLength.size() == trimeshPartitions.size());
+    }
+
+
+    //Get chart data, shared by all densities
+    sw_compute_chart_data.resume();
+    QuadRetopology::ChartData chartData = QuadRetopology::computeChartData(
+            trimesh,
+            trimeshPartitions,
+            trimeshCorners);
+    sw_compute_chart_data.stop();
+
+
+    //Split the threads between the densities and the charts of each density
+    const size_t numThreads = QuadRetopology::internal::numWorkerThreads(parameters.numThreads, std::numeric_limits<size_t>::max());
+    const size_t numConcurrent = std::min(numThreads, numDensities);
+
+    QuadRetopology::Parameters densityParameters = parameters;
+    densityParameters.numThreads = static_cast<int>(numThreads / std::max<size_t>(numConcurrent, 1));
+
+    //The pattern cache is shared by all densities, load and save it only once
+    QuadRetopology::internal::PatternCache& patternCache = QuadRetopology::internal::PatternCache::instance();
+    if (parameters.patternCache && !parameters.patternCacheFilename.empty()) {
+        patternCache.load(parameters.patternCacheFilename);
+    }
+    const size_t numCachedPatterns = patternCache.size();
+    densityParameters.patternCacheFilename.clear();
+
+    //quadrangulate updates the normals and marks the faces of the surface it
+    //reprojects on, so concurrent workers get their own copy of trimesh and
+    //trimesh is left to onQuadrangulation. The chart data refers to the face
+    //and vertex indices, which the copy keeps as trimesh is compact.
+    std::vector<std::unique_ptr<TriangleMesh>> workerMeshes;
+    if (numConcurrent > 1) {
+        assert(static_cast<size_t>(trimesh.vn) == trimesh.vert.size() && static_cast<size_t>(trimesh.fn) == trimesh.face.size());
+        for (size_t w = 0; w < numConcurrent; ++w) {
+            workerMeshes.emplace_back(new TriangleMesh());
+            vcg::tri::Append<TriangleMesh, TriangleMesh>::MeshCopy(*workerMeshes.back(), trimesh);
+            QuadRetopology::internal::updateAllMeshAttributes(*workerMeshes.back());
+        }
+    }
+
+    //Each worker solves its densities one after the other, so that the flow
+    //solver can warm-start from the previous density
+    std::vector<QuadRetopology::FlowSession> flowSessions(numConcurrent);
+    std::vector<std::optional<QuadrangulationResult>> density_results(numDensities);
+    QuadRetopology::internal::parallelForWorkers(numDensities, static_cast<int>(numConcurrent), [&](const size_t k, const size_t worker) {
+        HSW sw_density{"density"};
+        sw_density.resume();
+
+        PolyMesh quadmesh;
+        std::vector<std::vector<size_t>> quadmeshPartitions;
+        std::vector<std::vector<size_t>> quadmeshCorners;
+        std::vector<int> ilpResult;
+        density_results[k] = internal::quadrangulationFromChartData(
+                workerMeshes.empty() ? trimesh : *workerMeshes[worker],
+                chartData,
+                chartEdgeLengths[k],
+                densityParameters,
+                fixedChartClusters,
+                &flowSessions[worker],
+                quadmesh,
+                quadmeshPartitions,
+                quadmeshCorners,
+                ilpResult,
+                sw_density);
+
+        onQuadrangulation(k, quadmesh, quadmeshPartitions, quadmeshCorners, ilpResult);
+    });
+
+    if (parameters.patternCache && !parameters.patternCacheFilename.empty() && patternCache.size() > numCachedPatterns) {
+        if (!patternCache.save(parameters.patternCacheFilename)) {
+            std::cout << "Warning: could not save the pattern cache to " << parameters.patternCacheFilename << std::endl;
+        }
+    }
+
+    std::vector<QuadrangulationResult> results;
+    results.reserve(numDensities);
+    for (size_t k = 0; k < numDensities; ++k) {
+        results.push_back(std::move(*density_results[k]));
+        results.back().stopwatch.name = "density_" + std::to_string(k);
+    }
+
+    sw_root.stop();
+    auto sw_result = Timekeeper::HierarchicalStopWatchResult(sw_root);
+    for (const QuadrangulationResult& result : results) {
+        sw_result.add_child(result.stopwatch);
+    }
+    return {
+        .densities = std::move(results),
+        .stopwatch = sw_result};
+}
+
+}
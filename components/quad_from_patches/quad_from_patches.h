@@ -33,12 +33,18 @@ namespace qfp {
 
 struct QuadrangulationResult {
     std::vector<Satsuma::BiMDFFullResult> bimdf_results; // empty if ILP was used
+    std::vector<std::string> flow_solvers;
     std::vector<QuadRetopology::FlowStats> flow_stats;
     std::vector<std::vector<QuadRetopology::ILPStats>> ilp_stats_per_cluster;
     QuadRetopology::QuantizationEvaluation eval;
     Timekeeper::HierarchicalStopWatchResult stopwatch;
 };
 
+struct MultiDensityResult {
+    std::vector<QuadrangulationResult> densities; // same order as chartEdgeLengths
+    Timekeeper::HierarchicalStopWatchResult stopwatch;
+};
+
 template<class PolyMesh, class TriangleMesh>
 QuadrangulationResult
 quadrangulationFromPatches(
@@ -53,6 +59,22 @@ quadrangulationFromPatches(
     std::vector<std::vector<size_t>>& quadmeshCorners,
     std::vector<int>& ilpResult);
 
+//Quadrangulate the same patches once per entry of chartEdgeLengths. The chart data
+//is computed only once and the densities are solved in parallel (parameters.numThreads
+//is split between them). onQuadrangulation(k, quadmesh, quadmeshPartitions,
+//quadmeshCorners, ilpResult) is called from the worker thread as soon as density k
+//is done; the quad mesh is discarded afterwards.
+template<class PolyMesh, class TriangleMesh, class F>
+MultiDensityResult
+quadrangulationsFromPatches(
+    TriangleMesh& trimesh,
+    const std::vector<std::vector<size_t>>& trimeshPartitions,
+    const std::vector<std::vector<size_t>>& trimeshCorners,
+    const std::vector<std::vector<double>>& chartEdgeLengths,
+    const QuadRetopology::Parameters& parameters,
+    const int fixedChartClusters,
+    const F& onQuadrangulation);
+
 
 }
 
@@ -0,0 +1,350 @@
+#include "sidecar.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace sidecar {
+
+namespace {
+
+constexpr char MAGIC[8] = {'Q','W','S','I','D','E','C','R'};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t numArrays;
+};
+static_assert(sizeof(FileHeader) == 24);
+
+struct FileEntry {
+    uint32_t type;
+    uint32_t elementSize;
+    uint64_t count;
+    uint64_t offset;
+};
+static_assert(sizeof(FileEntry) == 24);
+
+constexpr uint64_t ALIGNMENT = 8;
+
+uint64_t align(uint64_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void checkEndianness()
+{
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("binary sidecar files are only supported on little-endian hosts");
+    }
+}
+
+} // namespace
+
+uint32_t toIndex32(size_t i)
+{
+    if (i > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("index does not fit into the binary sidecar format");
+    }
+    return static_cast<uint32_t>(i);
+}
+
+bool isBinary(const std::string& filename)
+{
+    std::ifstream input(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!input.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open " + filename);
+    }
+    fileHandle_ = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to get size of " + filename);
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0) {
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        throw std::runtime_error("failed to map " + filename);
+    }
+    mappingHandle_ = mapping;
+    data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("failed to map " + filename);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr) {
+        UnmapViewOfFile(data_);
+    }
+    if (mappingHandle_ != nullptr) {
+        CloseHandle(mappingHandle_);
+    }
+    if (fileHandle_ != nullptr) {
+        CloseHandle(fileHandle_);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to stat " + filename);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("failed to map " + filename);
+        }
+        data_ = static_cast<const char*>(ptr);
+    }
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+#endif
+
+Reader::Reader(const std::string& filename, Kind expected)
+    : filename_(filename)
+    , file_(filename)
+{
+    checkEndianness();
+
+    if (file_.size() < sizeof(FileHeader)) {
+        throw std::runtime_error(filename_ + ": file too small for a sidecar header");
+    }
+    FileHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(filename_ + ": not a binary sidecar file");
+    }
+    if (header.version != VERSION) {
+        throw std::runtime_error(filename_ + ": unsupported sidecar version " + std::to_string(header.version));
+    }
+    if (header.kind != static_cast<uint32_t>(expected)) {
+        throw std::runtime_error(filename_ + ": unexpected sidecar kind " + std::to_string(header.kind));
+    }
+    if (header.numArrays > (file_.size() - sizeof(FileHeader)) / sizeof(FileEntry)) {
+        throw std::runtime_error(filename_ + ": truncated array table");
+    }
+
+    entries_.reserve(header.numArrays);
+    for (uint64_t i = 0; i < header.numArrays; ++i) {
+        FileEntry fe;
+        std::memcpy(&fe, file_.data() + sizeof(FileHeader) + i * sizeof(FileEntry), sizeof(fe));
+        if (fe.elementSize == 0 || fe.offset % ALIGNMENT != 0 || fe.offset > file_.size()
+                || fe.count > (file_.size() - fe.offset) / fe.elementSize) {
+            throw std::runtime_error(filename_ + ": array " + std::to_string(i) + " out of bounds");
+        }
+        entries_.push_back({static_cast<ElementType>(fe.type), fe.elementSize, fe.count, fe.offset});
+    }
+}
+
+const Reader::Entry& Reader::entry(size_t i, ElementType type, size_t elementSize) const
+{
+    if (i >= entries_.size()) {
+        throw std::runtime_error(filename_ + ": missing array " + std::to_string(i));
+    }
+    const Entry& e = entries_[i];
+    if (e.type != type || e.elementSize != elementSize) {
+        throw std::runtime_error(filename_ + ": array " + std::to_string(i) + " has unexpected type");
+    }
+    return e;
+}
+
+void Writer::save(const std::string& filename) const
+{
+    checkEndianness();
+
+    FileHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.kind = static_cast<uint32_t>(kind_);
+    header.numArrays = arrays_.size();
+
+    std::vector<FileEntry> table;
+    uint64_t offset = align(sizeof(FileHeader) + arrays_.size() * sizeof(FileEntry));
+    for (const Array& a : arrays_) {
+        table.push_back({static_cast<uint32_t>(a.type), a.elementSize, a.count, offset});
+        offset = align(offset + a.bytes.size());
+    }
+
+    std::ofstream output(filename, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        throw std::runtime_error("failed to open " + filename + " for writing");
+    }
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(FileEntry));
+
+    const char padding[ALIGNMENT] = {};
+    uint64_t written = sizeof(FileHeader) + table.size() * sizeof(FileEntry);
+    for (size_t i = 0; i < arrays_.size(); ++i) {
+        output.write(padding, table[i].offset - written);
+        output.write(arrays_[i].bytes.data(), arrays_[i].bytes.size());
+        written = table[i].offset + arrays_[i].bytes.size();
+    }
+    if (!output) {
+        throw std::runtime_error("failed to write " + filename);
+    }
+}
+
+void savePatches(const std::string& filename, const std::vector<std::vector<size_t>>& partitions, size_t numFaces)
+{
+    std::vector<uint32_t> facePartition(numFaces, 0);
+    for (size_t pId = 0; pId < partitions.size(); ++pId) {
+        for (size_t fId : partitions[pId]) {
+            facePartition.at(fId) = toIndex32(pId);
+        }
+    }
+    Writer writer(Kind::Patch);
+    writer.addArray(facePartition);
+    writer.save(filename);
+}
+
+void saveCorners(const std::string& filename, const std::vector<std::vector<size_t>>& corners)
+{
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> vertices;
+    offsets.reserve(corners.size() + 1);
+    offsets.push_back(0);
+    for (const std::vector<size_t>& c : corners) {
+        for (size_t vId : c) {
+            vertices.push_back(toIndex32(vId));
+        }
+        offsets.push_back(vertices.size());
+    }
+    Writer writer(Kind::Corners);
+    writer.addArray(offsets);
+    writer.addArray(vertices);
+    writer.save(filename);
+}
+
+void saveFeatures(const std::string& filename, const std::vector<std::pair<size_t,size_t>>& features)
+{
+    std::vector<uint32_t> pairs;
+    pairs.reserve(2 * features.size());
+    for (const std::pair<size_t,size_t>& f : features) {
+        pairs.push_back(toIndex32(f.first));
+        pairs.push_back(toIndex32(f.second));
+    }
+    Writer writer(Kind::Feature);
+    writer.addArray(pairs);
+    writer.save(filename);
+}
+
+void saveFeatureCorners(const std::string& filename, const std::vector<size_t>& featureCorners)
+{
+    std::vector<uint32_t> vertices;
+    vertices.reserve(featureCorners.size());
+    for (size_t vId : featureCorners) {
+        vertices.push_back(toIndex32(vId));
+    }
+    Writer writer(Kind::FeatureCorners);
+    writer.addArray(vertices);
+    writer.save(filename);
+}
+
+std::vector<std::vector<size_t>> loadPatches(const std::string& filename)
+{
+    Reader reader(filename, Kind::Patch);
+    ArrayView<uint32_t> facePartition = reader.array<uint32_t>(0);
+
+    uint32_t maxPartitionId = 0;
+    for (uint32_t pId : facePartition) {
+        maxPartitionId = std::max(pId, maxPartitionId);
+    }
+
+    std::vector<std::vector<size_t>> partitions(facePartition.size() > 0 ? maxPartitionId + 1 : 0);
+    for (size_t fId = 0; fId < facePartition.size(); ++fId) {
+        partitions[facePartition[fId]].push_back(fId);
+    }
+    return partitions;
+}
+
+std::vector<std::vector<size_t>> loadCorners(const std::string& filename)
+{
+    Reader reader(filename, Kind::Corners);
+    ArrayView<uint64_t> offsets = reader.array<uint64_t>(0);
+    ArrayView<uint32_t> vertices = reader.array<uint32_t>(1);
+    if (offsets.size() == 0) {
+        throw std::runtime_error(filename + ": missing corner offsets");
+    }
+
+    std::vector<std::vector<size_t>> corners(offsets.size() - 1);
+    for (size_t i = 0; i < corners.size(); ++i) {
+        if (offsets[i] > offsets[i+1] || offsets[i+1] > vertices.size()) {
+            throw std::runtime_error(filename + ": invalid corner offsets");
+        }
+        corners[i].assign(vertices.begin() + offsets[i], vertices.begin() + offsets[i+1]);
+    }
+    return corners;
+}
+
+std::vector<std::pair<size_t,size_t>> loadFeatures(const std::string& filename)
+{
+    Reader reader(filename, Kind::Feature);
+    ArrayView<uint32_t> pairs = reader.array<uint32_t>(0);
+    if (pairs.size() % 2 != 0) {
+        throw std::runtime_error(filename + ": odd number of feature indices");
+    }
+
+    std::vector<std::pair<size_t,size_t>> features(pairs.size() / 2);
+    for (size_t i = 0; i < features.size(); ++i) {
+        features[i] = std::pair<size_t,size_t>(pairs[2*i], pairs[2*i+1]);
+    }
+    return features;
+}
+
+std::vector<size_t> loadFeatureCorners(const std::string& filename)
+{
+    Reader reader(filename, Kind::FeatureCorners);
+    ArrayView<uint32_t> vertices = reader.array<uint32_t>(0);
+    return std::vector<size_t>(vertices.begin(), vertices.end());
+}
+
+} // namespace sidecar
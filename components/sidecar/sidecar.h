@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Binary container for the pipeline sidecar files (.rosy, .sharp, .patch,
+/// .corners, .feature, .c_feature).
+///
+/// Layout, all little-endian:
+///   Header      magic "QWSIDECR", version, kind, number of arrays
+///   ArrayEntry  element type, element size, count, offset  (one per array)
+///   data        flat arrays, each starting at an 8-byte aligned offset
+///
+/// Files are read through a read-only memory mapping; Reader::array() returns
+/// views into the mapping without copying. The text formats stay supported,
+/// loaders pick the format by looking at the magic.
+namespace sidecar {
+
+static constexpr uint32_t VERSION = 1;
+
+enum class Kind : uint32_t {
+    Field = 1,          // arrays: PD1 (double, 3 per face), PD2 (double, 3 per face)
+    Sharp = 2,          // arrays: (type, face, edge) triples (uint32)
+    Patch = 3,          // arrays: partition id per face (uint32)
+    Corners = 4,        // arrays: offsets (uint64, n+1), vertex ids (uint32)
+    Feature = 5,        // arrays: (face, edge) pairs (uint32)
+    FeatureCorners = 6  // arrays: vertex ids (uint32)
+};
+
+enum class ElementType : uint32_t {
+    UInt32 = 1,
+    UInt64 = 2,
+    Double = 3
+};
+
+template<typename T> struct ElementTypeOf;
+template<> struct ElementTypeOf<uint32_t> { static constexpr ElementType value = ElementType::UInt32; };
+template<> struct ElementTypeOf<uint64_t> { static constexpr ElementType value = ElementType::UInt64; };
+template<> struct ElementTypeOf<double>   { static constexpr ElementType value = ElementType::Double; };
+
+template<typename T>
+struct ArrayView {
+    const T* data = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + count; }
+};
+
+/// True if the file exists and starts with the sidecar magic.
+bool isBinary(const std::string& filename);
+
+/// Index stored as uint32, throws std::runtime_error if it does not fit.
+uint32_t toIndex32(size_t i);
+
+/// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* fileHandle_ = nullptr;
+    void* mappingHandle_ = nullptr;
+#endif
+};
+
+/// Validates the header and array table of a sidecar file.
+/// Throws std::runtime_error on malformed files or kind mismatch.
+class Reader {
+public:
+    Reader(const std::string& filename, Kind expected);
+
+    size_t numArrays() const { return entries_.size(); }
+
+    template<typename T>
+    ArrayView<T> array(size_t i) const
+    {
+        const Entry& e = entry(i, ElementTypeOf<T>::value, sizeof(T));
+        return {reinterpret_cast<const T*>(file_.data() + e.offset), static_cast<size_t>(e.count)};
+    }
+
+private:
+    struct Entry {
+        ElementType type;
+        uint32_t elementSize;
+        uint64_t count;
+        uint64_t offset;
+    };
+    const Entry& entry(size_t i, ElementType type, size_t elementSize) const;
+
+    std::string filename_;
+    MappedFile file_;
+    std::vector<Entry> entries_;
+};
+
+/// Collects arrays and writes them in one go. Data is copied on add, so the
+/// source may go away before save().
+class Writer {
+public:
+    explicit Writer(Kind kind) : kind_(kind) {}
+
+    template<typename T>
+    void addArray(const T* data, size_t count)
+    {
+        const char* bytes = reinterpret_cast<const char*>(data);
+        arrays_.push_back({ElementTypeOf<T>::value,
+                           static_cast<uint32_t>(sizeof(T)),
+                           static_cast<uint64_t>(count),
+                           std::vector<char>(bytes, bytes + count * sizeof(T))});
+    }
+    template<typename T>
+    void addArray(const std::vector<T>& v) { addArray(v.data(), v.size()); }
+
+    /// Throws std::runtime_error if the file cannot be written.
+    void save(const std::string& filename) const;
+
+private:
+    struct Array {
+        ElementType type;
+        uint32_t elementSize;
+        uint64_t count;
+        std::vector<char> bytes;
+    };
+    Kind kind_;
+    std::vector<Array> arrays_;
+};
+
+// Patch layout files, same content as the text formats in quad_from_patches/load_save.h
+
+void savePatches(const std::string& filename, const std::vector<std::vector<size_t>>& partitions, size_t numFaces);
+void saveCorners(const std::string& filename, const std::vector<std::vector<size_t>>& corners);
+void saveFeatures(const std::string& filename, const std::vector<std::pair<size_t,size_t>>& features);
+void saveFeatureCorners(const std::string& filename, const std::vector<size_t>& featureCorners);
+
+std::vector<std::vector<size_t>> loadPatches(const std::string& filename);
+std::vector<std::vector<size_t>> loadCorners(const std::string& filename);
+std::vector<std::pair<size_t,size_t>> loadFeatures(const std::string& filename);
+std::vector<size_t> loadFeatureCorners(const std::string& filename);
+
+// Field computation files, same content as the text .rosy and .sharp formats.
+// The loaders hand the values to a callback, so they work for any mesh type.
+
+/// Calls setFace(faceId, pd1, pd2) with the 3 coordinates of both directions of
+/// each face. Returns false if the file does not hold numFaces faces.
+template<typename SetFace>
+bool loadField(const std::string& filename, size_t numFaces, SetFace setFace)
+{
+    Reader reader(filename, Kind::Field);
+    ArrayView<double> PD1 = reader.array<double>(0);
+    ArrayView<double> PD2 = reader.array<double>(1);
+    if ((PD1.size() != 3 * numFaces) || (PD2.size() != 3 * numFaces)) {
+        return false;
+    }
+    for (size_t fId = 0; fId < numFaces; ++fId) {
+        setFace(fId, &PD1[3 * fId], &PD2[3 * fId]);
+    }
+    return true;
+}
+
+/// Calls setSharp(type, faceId, edge) for each sharp edge, type 0 is concave and 1
+/// convex. Returns false on a malformed file or a face/edge out of range.
+template<typename SetSharp>
+bool loadSharp(const std::string& filename, size_t numFaces, SetSharp setSharp)
+{
+    Reader reader(filename, Kind::Sharp);
+    ArrayView<uint32_t> sharp = reader.array<uint32_t>(0);
+    if (sharp.size() % 3 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < sharp.size(); i += 3) {
+        if ((sharp[i] > 1) || (sharp[i + 1] >= numFaces) || (sharp[i + 2] >= 3)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < sharp.size(); i += 3) {
+        setSharp(static_cast<int>(sharp[i]), static_cast<size_t>(sharp[i + 1]), static_cast<size_t>(sharp[i + 2]));
+    }
+    return true;
+}
+
+} // namespace sidecar
@@ -2,6 +2,7 @@
 
 #include <patchgen/generate_topology.h>
 #include <determine_geometry.h>
+#include <mutex>
 
 using namespace Eigen;
 
@@ -14,3 +15,16 @@ void patterns::generatePatch(const patchgen::PatchParam& param, Patch& patch) {
     patchgen::generate_topology(param, patch);
     patterns::determine_geometry(patch, param.l);
 }
+
+void patterns::initPatternTables() {
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        const int num_patterns[7] = {0, 0, 2, 4, 5, 5, 4};
+        for (int num_sides = 2; num_sides <= 6; ++num_sides) {
+            for (int pattern_id = 0; pattern_id < num_patterns[num_sides]; ++pattern_id) {
+                patchgen::get_constraint_matrix(num_sides, pattern_id);
+                patchgen::get_variable_indicators(num_sides, pattern_id);
+            }
+        }
+    });
+}
@@ -5,4 +5,7 @@
 namespace patterns {
     void generatePatch(const Eigen::VectorXi& l, patchgen::PatchParam& param, Patch& patch);
     void generatePatch(const patchgen::PatchParam& param, Patch& patch);
+
+    // fill the lazily initialized pattern tables, call before generating patches concurrently
+    void initPatternTables();
 }
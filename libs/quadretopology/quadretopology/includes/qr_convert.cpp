@@ -26,6 +26,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "qr_convert.h"
 
 #include <vcg/complex/complex.h>
+#include <algorithm>
 
 namespace QuadRetopology {
 namespace internal {
@@ -85,6 +86,71 @@ void VCGToEigen(
     }
 }
 
+//Submesh made of the given faces. The cost only depends on the number of faces.
+//vMap is a scratch map from mesh vertices to submesh vertices that can be reused
+//between calls: it must have -1 for every mesh vertex (or be empty) on input and
+//on output it maps the vertices of the submesh; reset them with resetVertexMap.
+//Vertices and faces are in increasing index order, as in the selection version.
+template<class PolyMeshType>
+void VCGToEigen(
+        const PolyMeshType& vcgMesh,
+        const std::vector<size_t>& faces,
+        Eigen::MatrixXd& V,
+        Eigen::MatrixXi& F,
+        std::vector<size_t>& vertices,
+        std::vector<int>& vMap,
+        int numVerticesPerFace,
+        int dim)
+{
+    assert(dim >= 2);
+    assert(numVerticesPerFace > 2);
+
+    if (vMap.size() < vcgMesh.vert.size()) {
+        vMap.resize(vcgMesh.vert.size(), -1);
+    }
+
+    std::vector<size_t> sortedFaces(faces);
+    std::sort(sortedFaces.begin(), sortedFaces.end());
+
+    vertices.clear();
+    for (const size_t& fId : sortedFaces) {
+        assert(!vcgMesh.face[fId].IsD());
+        for (int j = 0; j < vcgMesh.face[fId].VN(); j++) {
+            size_t vId = vcg::tri::Index(vcgMesh, vcgMesh.face[fId].cV(j));
+            if (vMap[vId] == -1) {
+                vMap[vId] = 0;
+                vertices.push_back(vId);
+            }
+        }
+    }
+    std::sort(vertices.begin(), vertices.end());
+
+    V.resize(vertices.size(), dim);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        vMap[vertices[i]] = static_cast<int>(i);
+        for (int j = 0; j < dim; j++) {
+            V(i, j) = vcgMesh.vert[vertices[i]].cP()[j];
+        }
+    }
+
+    F.resize(sortedFaces.size(), numVerticesPerFace);
+    for (size_t i = 0; i < sortedFaces.size(); i++) {
+        const size_t& fId = sortedFaces[i];
+        for (int j = 0; j < vcgMesh.face[fId].VN(); j++) {
+            F(i, j) = vMap[vcg::tri::Index(vcgMesh, vcgMesh.face[fId].cV(j))];
+        }
+    }
+}
+
+inline void resetVertexMap(
+        const std::vector<size_t>& vertices,
+        std::vector<int>& vMap)
+{
+    for (const size_t& vId : vertices) {
+        vMap[vId] = -1;
+    }
+}
+
 template<class PolyMeshType>
 void eigenToVCG(
         const Eigen::MatrixXd& V,
@@ -43,6 +43,21 @@ void VCGToEigen(
         int numVerticesPerFace = 3,
         int dim = 3);
 
+template<class PolyMeshType>
+void VCGToEigen(
+        const PolyMeshType& vcgMesh,
+        const std::vector<size_t>& faces,
+        Eigen::MatrixXd& V,
+        Eigen::MatrixXi& F,
+        std::vector<size_t>& vertices,
+        std::vector<int>& vMap,
+        int numVerticesPerFace = 3,
+        int dim = 3);
+
+inline void resetVertexMap(
+        const std::vector<size_t>& vertices,
+        std::vector<int>& vMap);
+
 template<class PolyMeshType>
 void eigenToVCG(
         const Eigen::MatrixXd& V,
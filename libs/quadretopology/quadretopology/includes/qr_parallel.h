@@ -0,0 +1,106 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef QR_PARALLEL_H
+#define QR_PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+namespace QuadRetopology {
+namespace internal {
+
+//Number of worker threads for numTasks tasks (numThreads <= 0: all hardware threads)
+inline size_t numWorkerThreads(const int numThreads, const size_t numTasks)
+{
+    size_t n = numThreads > 0 ? static_cast<size_t>(numThreads) : std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min(n, numTasks));
+}
+
+//Call f(i, worker) for each i in [0, n) on numThreads threads, worker is the index
+//of the calling thread in [0, numWorkerThreads(numThreads, n)) and can be used to
+//address per-thread scratch data. Indices are handed out one at a time, so tasks
+//of uneven cost are balanced. The first exception thrown by a task is rethrown
+//after all threads joined.
+template<class F>
+void parallelForWorkers(const size_t n, const int numThreads, const F& f)
+{
+    const size_t nThreads = numWorkerThreads(numThreads, n);
+    if (nThreads <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            f(i, 0);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&](const size_t w) {
+        for (size_t i = next++; i < n; i = next++) {
+            try {
+                f(i, w);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = n;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads - 1);
+    for (size_t t = 1; t < nThreads; ++t) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+//Call f(i) for each i in [0, n) on numThreads threads, see parallelForWorkers
+template<class F>
+void parallelFor(const size_t n, const int numThreads, const F& f)
+{
+    parallelForWorkers(n, numThreads, [&f](const size_t i, const size_t) { f(i); });
+}
+
+}
+}
+
+#endif // QR_PARALLEL_H
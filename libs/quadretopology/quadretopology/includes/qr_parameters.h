@@ -59,6 +59,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define DEFAULTQUADRANGULATIONFIXEDSMOOTHINGITERATIONS 5
 #define DEFAULTQUADRANGULATIONNONFIXEDSMOOTHINGITERATIONS 5
 #define DEFAULTDOUBLETREMOVAL true
+#define DEFAULTNUMTHREADS 1 //0: one per hardware thread
+#define DEFAULTPATTERNCACHE false //canonical patterns can differ from solving each chart directly
 
 #define DEFAULTRESULTSMOOTHINGITERATIONS 5
 #define DEFAULTRESULTSMOOTHINGNRING 3
@@ -108,6 +110,9 @@ struct Parameters {
     int quadrangulationFixedSmoothingIterations;
     int quadrangulationNonFixedSmoothingIterations;
     bool doubletRemoval;
+    int numThreads;
+    bool patternCache;
+    std::string patternCacheFilename; //if not empty, patterns are loaded from and saved to this file
     
     int resultSmoothingIterations;
     double resultSmoothingNRing;
@@ -145,6 +150,8 @@ struct Parameters {
         quadrangulationFixedSmoothingIterations = DEFAULTQUADRANGULATIONFIXEDSMOOTHINGITERATIONS;
         quadrangulationNonFixedSmoothingIterations = DEFAULTQUADRANGULATIONNONFIXEDSMOOTHINGITERATIONS;
         doubletRemoval = DEFAULTDOUBLETREMOVAL;
+        numThreads = DEFAULTNUMTHREADS;
+        patternCache = DEFAULTPATTERNCACHE;
         
         resultSmoothingIterations = DEFAULTRESULTSMOOTHINGITERATIONS;
         resultSmoothingNRing = DEFAULTRESULTSMOOTHINGNRING;
@@ -29,6 +29,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <patterns/generate_patch.h>
 
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+
 namespace QuadRetopology {
 namespace internal {
 
@@ -135,5 +139,267 @@ void computePattern(
     } while (cId != startCornerId);
 }
 
+
+inline PatternCache& PatternCache::instance()
+{
+    static PatternCache cache;
+    return cache;
+}
+
+inline std::shared_ptr<const PatternData> PatternCache::find(const std::vector<int>& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = patterns.find(key);
+    if (it == patterns.end())
+        return nullptr;
+    return it->second;
+}
+
+inline std::shared_ptr<const PatternData> PatternCache::insert(const std::vector<int>& key, std::shared_ptr<const PatternData> pattern)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return patterns.emplace(key, std::move(pattern)).first->second;
+}
+
+inline size_t PatternCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return patterns.size();
+}
+
+inline void PatternCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    patterns.clear();
+}
+
+namespace patterncache {
+
+static const char MAGIC[8] = {'Q','R','P','A','T','T','N','1'};
+
+template<class T>
+inline void write(std::ofstream& output, const T& value)
+{
+    output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T>
+inline bool read(std::ifstream& input, T& value)
+{
+    return static_cast<bool>(input.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+}
+
+inline bool PatternCache::load(const std::string& filename)
+{
+    std::ifstream input(filename, std::ios::binary);
+    if (!input.is_open())
+        return false;
+
+    char magic[8];
+    if (!input.read(magic, 8) || !std::equal(magic, magic + 8, patterncache::MAGIC))
+        return false;
+
+    uint64_t numPatterns;
+    if (!patterncache::read(input, numPatterns))
+        return false;
+
+    for (uint64_t p = 0; p < numPatterns; p++) {
+        uint32_t numSides, numV, numF;
+        if (!patterncache::read(input, numSides) || numSides < 2 || numSides > 6)
+            return false;
+
+        std::vector<int> key(numSides);
+        for (int32_t& value : key)
+            if (!patterncache::read(input, value))
+                return false;
+
+        std::shared_ptr<PatternData> pattern = std::make_shared<PatternData>();
+        if (!patterncache::read(input, numV) || !patterncache::read(input, numF))
+            return false;
+        pattern->V.resize(numV, 3);
+        pattern->F.resize(numF, 4);
+        for (uint32_t i = 0; i < numV; i++)
+            for (int j = 0; j < 3; j++)
+                if (!patterncache::read(input, pattern->V(i, j)))
+                    return false;
+        for (uint32_t i = 0; i < numF; i++)
+            for (int j = 0; j < 4; j++) {
+                int32_t value;
+                if (!patterncache::read(input, value) || value < 0 || static_cast<uint32_t>(value) >= numV)
+                    return false;
+                pattern->F(i, j) = value;
+            }
+
+        pattern->corners.resize(numSides);
+        for (size_t& c : pattern->corners) {
+            uint32_t value;
+            if (!patterncache::read(input, value) || value >= numV)
+                return false;
+            c = value;
+        }
+        pattern->sides.resize(numSides);
+        for (std::vector<size_t>& side : pattern->sides) {
+            uint32_t sideSize;
+            if (!patterncache::read(input, sideSize) || sideSize > numV)
+                return false;
+            side.resize(sideSize);
+            for (size_t& v : side) {
+                uint32_t value;
+                if (!patterncache::read(input, value) || value >= numV)
+                    return false;
+                v = value;
+            }
+        }
+
+        insert(key, pattern);
+    }
+
+    return true;
+}
+
+inline bool PatternCache::save(const std::string& filename) const
+{
+    std::ofstream output(filename, std::ios::binary | std::ios::trunc);
+    if (!output.is_open())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    output.write(patterncache::MAGIC, 8);
+    patterncache::write(output, static_cast<uint64_t>(patterns.size()));
+    for (const auto& entry : patterns) {
+        const std::vector<int>& key = entry.first;
+        const PatternData& pattern = *entry.second;
+
+        patterncache::write(output, static_cast<uint32_t>(key.size()));
+        for (const int& value : key)
+            patterncache::write(output, static_cast<int32_t>(value));
+
+        patterncache::write(output, static_cast<uint32_t>(pattern.V.rows()));
+        patterncache::write(output, static_cast<uint32_t>(pattern.F.rows()));
+        for (int i = 0; i < pattern.V.rows(); i++)
+            for (int j = 0; j < 3; j++)
+                patterncache::write(output, static_cast<double>(pattern.V(i, j)));
+        for (int i = 0; i < pattern.F.rows(); i++)
+            for (int j = 0; j < 4; j++)
+                patterncache::write(output, static_cast<int32_t>(pattern.F(i, j)));
+
+        for (const size_t& c : pattern.corners)
+            patterncache::write(output, static_cast<uint32_t>(c));
+        for (const std::vector<size_t>& side : pattern.sides) {
+            patterncache::write(output, static_cast<uint32_t>(side.size()));
+            for (const size_t& v : side)
+                patterncache::write(output, static_cast<uint32_t>(v));
+        }
+    }
+
+    return static_cast<bool>(output);
+}
+
+//Subdivision vector l transformed by an optional flip (reversed side order)
+//followed by a rotation: result[i] = flipped[(i + rotation) % n]
+inline std::vector<int> transformSubdivisions(const std::vector<int>& l, const bool flip, const size_t rotation)
+{
+    const size_t n = l.size();
+    std::vector<int> result(n);
+    for (size_t i = 0; i < n; i++) {
+        size_t j = (i + rotation) % n;
+        result[i] = flip ? l[n - 1 - j] : l[j];
+    }
+    return result;
+}
+
+template<class PolyMesh>
+void computePatternCached(
+        const Eigen::VectorXi &l,
+        Eigen::MatrixXd& patchV,
+        Eigen::MatrixXi& patchF,
+        PolyMesh& patchMesh,
+        std::vector<size_t>& borders,
+        std::vector<size_t>& corners,
+        std::vector<std::vector<size_t>>& sides)
+{
+    const size_t n = l.size();
+    if (n < 2 || 6 < n) {
+        computePattern(l, patchV, patchF, patchMesh, borders, corners, sides);
+        return;
+    }
+
+    //Canonical subdivision vector: the smallest of its rotations and flips
+    std::vector<int> lVec(l.data(), l.data() + n);
+    std::vector<int> key = lVec;
+    for (int flip = 0; flip < 2; flip++) {
+        for (size_t rotation = 0; rotation < n; rotation++) {
+            key = std::min(key, transformSubdivisions(lVec, flip, rotation));
+        }
+    }
+
+    PatternCache& cache = PatternCache::instance();
+    std::shared_ptr<const PatternData> pattern = cache.find(key);
+    if (pattern == nullptr) {
+        std::shared_ptr<PatternData> newPattern = std::make_shared<PatternData>();
+        Eigen::VectorXi keyL = Eigen::Map<const Eigen::VectorXi>(key.data(), n);
+        PolyMesh keyMesh;
+        std::vector<size_t> keyBorders;
+        computePattern(keyL, newPattern->V, newPattern->F, keyMesh, keyBorders, newPattern->corners, newPattern->sides);
+        if (newPattern->sides.size() != n) {
+            //Invalid subdivision vector, nothing to cache
+            computePattern(l, patchV, patchF, patchMesh, borders, corners, sides);
+            return;
+        }
+        pattern = cache.insert(key, newPattern);
+    }
+
+    //Transformation from the canonical vector to l
+    bool flip = false;
+    size_t rotation = 0;
+    bool found = false;
+    for (int f = 0; f < 2 && !found; f++) {
+        for (size_t r = 0; r < n && !found; r++) {
+            if (transformSubdivisions(key, f, r) == lVec) {
+                flip = f;
+                rotation = r;
+                found = true;
+            }
+        }
+    }
+    assert(found);
+
+    //Flip: mirror the geometry, reverse the faces and go around the other way
+    patchV = pattern->V;
+    patchF = pattern->F;
+    std::vector<size_t> flippedCorners = pattern->corners;
+    std::vector<std::vector<size_t>> flippedSides = pattern->sides;
+    if (flip) {
+        patchV.col(0) *= -1;
+        for (int i = 0; i < patchF.rows(); i++) {
+            patchF.row(i).reverseInPlace();
+        }
+        for (size_t i = 0; i < n; i++) {
+            flippedCorners[i] = pattern->corners[(n - i) % n];
+            flippedSides[i] = pattern->sides[n - 1 - i];
+            std::reverse(flippedSides[i].begin(), flippedSides[i].end());
+        }
+    }
+
+    //Rotation
+    corners.resize(n);
+    sides.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        corners[i] = flippedCorners[(i + rotation) % n];
+        sides[i] = flippedSides[(i + rotation) % n];
+    }
+
+    borders.clear();
+    for (size_t i = 0; i < n; i++) {
+        borders.insert(borders.end(), sides[i].begin(), sides[i].end() - 1);
+    }
+
+    eigenToVCG(patchV, patchF, patchMesh, 4, 3);
+    vcg::tri::UpdateTopology<PolyMesh>::FaceFace(patchMesh);
+}
+
 }
 }
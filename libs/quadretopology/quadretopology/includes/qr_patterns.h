@@ -27,6 +27,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define QR_PATTERNS_H
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 #include <Eigen/Core>
 
@@ -43,6 +47,49 @@ void computePattern(
         std::vector<size_t>& corners,
         std::vector<std::vector<size_t>>& sides);
 
+//Pattern of a side subdivision vector, as computed by computePattern
+struct PatternData {
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    std::vector<size_t> corners;
+    std::vector<std::vector<size_t>> sides;
+};
+
+//Thread-safe cache of patterns, keyed by the subdivision vector up to rotation
+//and flip. It can be stored on disk to be reused by later runs.
+class PatternCache {
+public:
+    static PatternCache& instance();
+
+    std::shared_ptr<const PatternData> find(const std::vector<int>& key) const;
+    //Returns the pattern in the cache, which is the existing one if key was already there
+    std::shared_ptr<const PatternData> insert(const std::vector<int>& key, std::shared_ptr<const PatternData> pattern);
+
+    size_t size() const;
+    void clear();
+
+    //Adds the patterns of the file, returns false if it cannot be read
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::vector<int>, std::shared_ptr<const PatternData>> patterns;
+};
+
+//Same as computePattern, but takes the pattern from the cache if possible.
+//The pattern is always generated for the canonical rotation/flip of l, so the
+//result does not depend on the order the charts are processed in.
+template<class PolyMesh>
+void computePatternCached(
+        const Eigen::VectorXi &l,
+        Eigen::MatrixXd& patchV,
+        Eigen::MatrixXi& patchF,
+        PolyMesh& patchMesh,
+        std::vector<size_t>& borders,
+        std::vector<size_t>& corners,
+        std::vector<std::vector<size_t>>& sides);
+
 }
 }
 
@@ -0,0 +1,214 @@
+/***************************************************************************/
+/* Copyright(C) 2021
+
+
+The authors of
+
+Reliable Feature-Line Driven Quad-Remeshing
+Siggraph 2021
+
+
+ All rights reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef QR_PORTFOLIO_H
+#define QR_PORTFOLIO_H
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <limits>
+#include <utility>
+
+namespace QuadRetopology {
+namespace internal {
+
+//Threads that may outlive the call that started them, e.g. portfolio solvers that are
+//still running when the time limit ran out. Finished threads are joined whenever a new
+//one is started, the others by joinAll, at the latest when the process exits.
+class BackgroundThreads
+{
+public:
+    static BackgroundThreads& instance()
+    {
+        static BackgroundThreads threads;
+        return threads;
+    }
+
+    ~BackgroundThreads()
+    {
+        joinAll();
+    }
+
+    template<class F>
+    void start(F f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        joinFinished();
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        threads.push_back({std::thread([f = std::move(f), done]() mutable {
+            f();
+            *done = true;
+        }), done});
+    }
+
+    //Blocks until all threads started so far returned
+    void joinAll()
+    {
+        std::vector<Entry> running;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running.swap(threads);
+        }
+        for (Entry& entry : running) {
+            entry.thread.join();
+        }
+    }
+
+private:
+    struct Entry {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+
+    BackgroundThreads() = default;
+
+    void joinFinished()
+    {
+        auto finished = [](Entry& entry) {
+            if (!*entry.done) {
+                return false;
+            }
+            entry.thread.join();
+            return true;
+        };
+        threads.erase(std::remove_if(threads.begin(), threads.end(), finished), threads.end());
+    }
+
+    std::mutex mutex;
+    std::vector<Entry> threads;
+};
+
+//Solves the same problem in a different way. solve returns the solution and its cost,
+//or nothing if it failed or gave up because stop was set. stop is set as soon as the
+//portfolio returned: a candidate should check it between its phases, the losers are
+//left to finish on BackgroundThreads otherwise. Fallbacks are cheap candidates (e.g. a
+//solution that is already known) that keep the wait after the time limit short.
+template<class Result>
+struct PortfolioCandidate {
+    std::function<std::optional<std::pair<Result, double>>(const std::atomic<bool>& stop)> solve;
+    bool fallback = false;
+};
+
+template<class Result>
+struct PortfolioOutcome {
+    std::optional<Result> result; //empty if no candidate found a solution
+    size_t winner = 0;
+    double cost = std::numeric_limits<double>::infinity();
+    size_t nFinished = 0;
+    bool allFinished = false; //no candidate was skipped or cut off
+};
+
+//Run the candidates concurrently and return the cheapest result available when stop
+//is reached, or once all candidates returned if there is no stop. The limit is soft:
+//if no candidate has a result by then, this waits for the first one that finishes,
+//which a fallback candidate keeps short. If stop has passed already, only the fallback
+//candidates are started (all of them if there are none).
+template<class Result>
+PortfolioOutcome<Result> runPortfolio(
+        const std::vector<PortfolioCandidate<Result>>& candidates,
+        const std::optional<std::chrono::steady_clock::time_point>& stop)
+{
+    struct State {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::optional<Result>> results;
+        std::vector<double> costs;
+        size_t nDone = 0;
+        size_t nSkipped = 0;
+        size_t nValid = 0;
+        std::atomic<bool> stop{false};
+    };
+    auto state = std::make_shared<State>();
+    state->results.resize(candidates.size());
+    state->costs.resize(candidates.size(), std::numeric_limits<double>::infinity());
+
+    const bool late = stop && std::chrono::steady_clock::now() >= *stop;
+    const bool anyFallback = std::any_of(candidates.begin(), candidates.end(),
+                                         [](const PortfolioCandidate<Result>& c) { return c.fallback; });
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (late && anyFallback && !candidates[i].fallback) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            ++state->nSkipped;
+            continue;
+        }
+        BackgroundThreads::instance().start([state, i, solve = candidates[i].solve]() {
+            std::optional<std::pair<Result, double>> res;
+            try {
+                res = solve(state->stop);
+            }
+            catch (...) {
+                res.reset();
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (res) {
+                state->results[i] = std::move(res->first);
+                state->costs[i] = res->second;
+                ++state->nValid;
+            }
+            ++state->nDone;
+            state->cv.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    auto allDone = [&] { return state->nDone + state->nSkipped == candidates.size(); };
+    if (stop) {
+        state->cv.wait_until(lock, *stop, allDone);
+        state->cv.wait(lock, [&] { return state->nValid > 0 || allDone(); });
+    }
+    else {
+        state->cv.wait(lock, allDone);
+    }
+    state->stop = true;
+
+    PortfolioOutcome<Result> outcome;
+    outcome.nFinished = state->nDone;
+    outcome.allFinished = state->nDone == candidates.size();
+    bool found = false;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (state->results[i] && (!found || state->costs[i] < outcome.cost)) {
+            outcome.winner = i;
+            outcome.cost = state->costs[i];
+            found = true;
+        }
+    }
+    if (found) {
+        outcome.result = std::move(state->results[outcome.winner]);
+    }
+    return outcome;
+}
+
+}
+}
+
+#endif // QR_PORTFOLIO_H
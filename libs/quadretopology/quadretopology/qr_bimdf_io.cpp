@@ -0,0 +1,262 @@
+#include "qr_bimdf_io.h"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+
+namespace QuadRetopology {
+
+namespace {
+
+constexpr char MAGIC[8] = {'Q','R','B','I','M','D','F','\0'};
+
+enum class CostKind : uint8_t {
+    Zero = 0,           // parameters: guess, unused
+    AbsDeviation = 1,   // parameters: target, weight
+    QuadDeviation = 2   // parameters: target, weight
+};
+
+enum EdgeFlags : uint8_t {
+    U_HEAD = 1,
+    V_HEAD = 2
+};
+
+void checkEndianness()
+{
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Bi-MDF instance files are only supported on little-endian hosts");
+    }
+}
+
+class Output {
+public:
+    explicit Output(const std::string& filename)
+        : filename_(filename), out_(filename, std::ios::binary) {
+        if (!out_) {
+            throw std::runtime_error("cannot open Bi-MDF instance file " + filename + " for writing");
+        }
+    }
+    template<typename T>
+    void write(const T& value) {
+        out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void writeBytes(const char* data, size_t size) {
+        out_.write(data, static_cast<std::streamsize>(size));
+    }
+    void close() {
+        out_.close();
+        if (!out_) {
+            throw std::runtime_error("failed to write Bi-MDF instance file " + filename_);
+        }
+    }
+private:
+    std::string filename_;
+    std::ofstream out_;
+};
+
+class Input {
+public:
+    explicit Input(const std::string& filename)
+        : filename_(filename), in_(filename, std::ios::binary) {
+        if (!in_) {
+            throw std::runtime_error("cannot open Bi-MDF instance file " + filename);
+        }
+        in_.seekg(0, std::ios::end);
+        remaining_ = static_cast<uint64_t>(in_.tellg());
+        in_.seekg(0, std::ios::beg);
+    }
+    template<typename T>
+    T read() {
+        T value;
+        readBytes(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+    void readBytes(char* data, size_t size) {
+        if (size > remaining_ || !in_.read(data, static_cast<std::streamsize>(size))) {
+            fail("unexpected end of file");
+        }
+        remaining_ -= size;
+    }
+    // Check a count read from the file before allocating for it
+    void checkFits(uint64_t count, size_t item_size, const std::string& what) const {
+        if (count > remaining_ / item_size) {
+            fail(what + " does not fit in the rest of the file");
+        }
+    }
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error("malformed Bi-MDF instance file " + filename_ + ": " + what);
+    }
+private:
+    std::string filename_;
+    std::ifstream in_;
+    uint64_t remaining_ = 0;
+};
+
+uint32_t toIndex32(size_t i)
+{
+    if (i > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("index does not fit into the Bi-MDF instance format");
+    }
+    return static_cast<uint32_t>(i);
+}
+
+// u, v, flags, kind, two cost parameters, lower, upper
+constexpr size_t EDGE_BYTES = 2 * sizeof(uint32_t) + 2 * sizeof(uint8_t) + 2 * sizeof(double) + 2 * sizeof(int64_t);
+
+} // namespace
+
+std::unique_ptr<Satsuma::BiMDF> BiMDFInstance::to_bimdf(std::vector<Satsuma::BiMDF::Edge>* out_edges) const
+{
+    using Scalar = std::decay_t<decltype(Satsuma::BiMDF::inf())>;
+    auto bimdf = std::make_unique<Satsuma::BiMDF>();
+    std::vector<Satsuma::BiMDF::Node> nodes;
+    nodes.reserve(n_nodes);
+    for (uint32_t i = 0; i < n_nodes; ++i) {
+        nodes.push_back(bimdf->add_node());
+    }
+    if (out_edges) {
+        out_edges->clear();
+        out_edges->reserve(edges.size());
+    }
+    for (const Edge& edge : edges) {
+        auto e = bimdf->add_edge({
+                .u = nodes.at(edge.u), .v = nodes.at(edge.v),
+                .u_head = edge.u_head, .v_head = edge.v_head,
+                .cost_function = edge.cost_function,
+                .lower = static_cast<Scalar>(edge.lower),
+                .upper = edge.upper == UNBOUNDED ? Satsuma::BiMDF::inf() : static_cast<Scalar>(edge.upper)});
+        if (out_edges) {
+            out_edges->push_back(e);
+        }
+    }
+    return bimdf;
+}
+
+void saveBiMDFInstance(const std::string& filename, const BiMDFInstance& instance)
+{
+    checkEndianness();
+    Output out(filename);
+    out.writeBytes(MAGIC, sizeof(MAGIC));
+    out.write<uint32_t>(BiMDFInstance::VERSION);
+    out.write<uint32_t>(instance.n_nodes);
+    out.write<uint64_t>(instance.edges.size());
+    out.write<double>(instance.cost_offset);
+
+    for (const BiMDFInstance::Edge& edge : instance.edges) {
+        CostKind kind;
+        double a = 0.;
+        double b = 0.;
+        if (auto cf = std::get_if<Satsuma::CostFunction::Zero>(&edge.cost_function)) {
+            kind = CostKind::Zero;
+            a = cf->guess;
+        } else if (auto cf = std::get_if<Satsuma::CostFunction::AbsDeviation>(&edge.cost_function)) {
+            kind = CostKind::AbsDeviation;
+            a = cf->target;
+            b = cf->weight;
+        } else if (auto cf = std::get_if<Satsuma::CostFunction::QuadDeviation>(&edge.cost_function)) {
+            kind = CostKind::QuadDeviation;
+            a = cf->target;
+            b = cf->weight;
+        } else {
+            throw std::runtime_error("Bi-MDF instance: unsupported cost function");
+        }
+        out.write<uint32_t>(edge.u);
+        out.write<uint32_t>(edge.v);
+        out.write<uint8_t>((edge.u_head ? U_HEAD : 0) | (edge.v_head ? V_HEAD : 0));
+        out.write<uint8_t>(static_cast<uint8_t>(kind));
+        out.write<double>(a);
+        out.write<double>(b);
+        out.write<int64_t>(edge.lower);
+        out.write<int64_t>(edge.upper);
+    }
+
+    out.write<uint32_t>(toIndex32(instance.edge_groups.size()));
+    for (const auto& [name, group] : instance.edge_groups) {
+        out.write<uint32_t>(toIndex32(name.size()));
+        out.writeBytes(name.data(), name.size());
+        out.write<uint64_t>(group.size());
+        out.writeBytes(reinterpret_cast<const char*>(group.data()), group.size() * sizeof(uint32_t));
+    }
+    out.close();
+}
+
+BiMDFInstance loadBiMDFInstance(const std::string& filename)
+{
+    checkEndianness();
+    Input in(filename);
+    char magic[sizeof(MAGIC)];
+    in.readBytes(magic, sizeof(magic));
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        in.fail("wrong magic");
+    }
+    const uint32_t version = in.read<uint32_t>();
+    if (version != BiMDFInstance::VERSION) {
+        in.fail("unsupported version " + std::to_string(version));
+    }
+
+    BiMDFInstance instance;
+    instance.n_nodes = in.read<uint32_t>();
+    const uint64_t n_edges = in.read<uint64_t>();
+    instance.cost_offset = in.read<double>();
+
+    in.checkFits(n_edges, EDGE_BYTES, "edge count " + std::to_string(n_edges));
+    instance.edges.reserve(n_edges);
+    for (uint64_t i = 0; i < n_edges; ++i) {
+        BiMDFInstance::Edge edge;
+        edge.u = in.read<uint32_t>();
+        edge.v = in.read<uint32_t>();
+        const uint8_t flags = in.read<uint8_t>();
+        const uint8_t kind = in.read<uint8_t>();
+        const double a = in.read<double>();
+        const double b = in.read<double>();
+        edge.lower = in.read<int64_t>();
+        edge.upper = in.read<int64_t>();
+        if (edge.u >= instance.n_nodes || edge.v >= instance.n_nodes) {
+            in.fail("edge " + std::to_string(i) + " references a node out of range");
+        }
+        edge.u_head = (flags & U_HEAD) != 0;
+        edge.v_head = (flags & V_HEAD) != 0;
+        switch (static_cast<CostKind>(kind)) {
+        case CostKind::Zero:
+            edge.cost_function = Satsuma::CostFunction::Zero{.guess = a};
+            break;
+        case CostKind::AbsDeviation:
+            edge.cost_function = Satsuma::CostFunction::AbsDeviation{.target = a, .weight = b};
+            break;
+        case CostKind::QuadDeviation:
+            edge.cost_function = Satsuma::CostFunction::QuadDeviation{.target = a, .weight = b};
+            break;
+        default:
+            in.fail("unknown cost function kind " + std::to_string(kind));
+        }
+        instance.edges.push_back(std::move(edge));
+    }
+
+    const uint32_t n_groups = in.read<uint32_t>();
+    for (uint32_t i = 0; i < n_groups; ++i) {
+        const uint32_t name_size = in.read<uint32_t>();
+        in.checkFits(name_size, 1, "name of edge group " + std::to_string(i));
+        std::string name(name_size, '\0');
+        in.readBytes(name.data(), name.size());
+        const uint64_t size = in.read<uint64_t>();
+        if (size > n_edges) {
+            in.fail("edge group '" + name + "' is larger than the network");
+        }
+        in.checkFits(size, sizeof(uint32_t), "edge group '" + name + "'");
+        std::vector<uint32_t> group(size);
+        in.readBytes(reinterpret_cast<char*>(group.data()), size * sizeof(uint32_t));
+        for (uint32_t e : group) {
+            if (e >= n_edges) {
+                in.fail("edge group '" + name + "' references an edge out of range");
+            }
+        }
+        instance.edge_groups.emplace_back(std::move(name), std::move(group));
+    }
+    return instance;
+}
+
+} // namespace QuadRetopology
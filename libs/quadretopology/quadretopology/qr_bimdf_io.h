@@ -0,0 +1,51 @@
+#pragma once
+
+#include <libsatsuma/Problems/BiMDF.hh>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace QuadRetopology {
+
+/// A Bi-MDF network as built by findSubdivisionsFlow, independent of the
+/// quadrangulation data, so that solver configurations can be benchmarked on
+/// reproducible instances (see components/bimdf_bench).
+///
+/// File layout, all little-endian:
+///   header      magic "QRBIMDF", version, number of nodes, number of edges, cost offset
+///   edges       u, v, head flags, cost kind, two cost parameters, lower, upper
+///   edge groups name, number of edges, edge indices
+struct BiMDFInstance {
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int64_t UNBOUNDED = -1; // upper bound of uncapacitated edges
+
+    struct Edge {
+        uint32_t u, v;
+        bool u_head, v_head;
+        Satsuma::CostFunction::Function cost_function;
+        int64_t lower = 0;
+        int64_t upper = UNBOUNDED;
+    };
+
+    uint32_t n_nodes = 0;
+    std::vector<Edge> edges;
+    /// tagged subsets of edges (indices into edges), e.g. "unpaired" or
+    /// "emergency_neighbor_v5", same grouping as FlowStats
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> edge_groups;
+    /// constant cost removed by the network reduction, add to the network cost
+    double cost_offset = 0.;
+
+    /// Build the network, edges[i] is added as the i-th edge of the graph.
+    /// If out_edges is given, it receives the edge handles in the same order.
+    std::unique_ptr<Satsuma::BiMDF> to_bimdf(std::vector<Satsuma::BiMDF::Edge>* out_edges = nullptr) const;
+};
+
+/// Throws std::runtime_error if the file cannot be written.
+void saveBiMDFInstance(const std::string& filename, const BiMDFInstance& instance);
+
+/// Throws std::runtime_error on unreadable or malformed files.
+BiMDFInstance loadBiMDFInstance(const std::string& filename);
+
+} // namespace QuadRetopology
@@ -26,11 +26,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "qr_flow_config.h"
 #include "qr_singularity_pairs.h"
 #include "qr_eval_quantization.h"
+#include "qr_bimdf_io.h"
+#include "includes/qr_parallel.h"
+#include "includes/qr_portfolio.h"
 
 #include <iostream>
 #include <vector>
 #include <memory>
 #include <optional>
+#include <map>
+#include <tuple>
+#include <numeric>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
 
 #include <libsatsuma/Problems/BiMDF.hh>
 #include <libsatsuma/Extra/Highlevel.hh>
@@ -40,9 +53,51 @@ namespace QuadRetopology {
 using Satsuma::BiMDF;
 using Node = Satsuma::BiMDF::Node;
 using Edge = Satsuma::BiMDF::Edge;
+using FlowScalar = std::decay_t<decltype(BiMDF::inf())>;
+
+/// Identifies a network node independently of the node handle, so that nodes of a
+/// re-built network can be matched to the nodes of the previous one.
+/// half is 0/1 for the two nodes of a paired side or subside, -1 otherwise.
+struct NodeRole {
+    enum class Kind { Side, Subside, Boundary };
+    Kind kind;
+    int id = -1;   // chart id for sides, subside id for subsides
+    int idx = -1;  // side index within the chart
+    int half = -1;
+    auto operator<=>(const NodeRole&) const = default;
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct SolverCandidate {
+    std::string name;
+    Satsuma::BiMDFSolverConfig config;
+    bool approximation = false; // double-cover rounding without matching refinement
+};
+
+struct PortfolioResult {
+    std::optional<Satsuma::BiMDFFullResult> result; // empty if the fallback solution was kept
+    size_t solver; // index of the winning SolverCandidate, solvers.size() for the fallback
+    bool all_finished;
+};
+
+struct EdgeRecord {
+    Edge edge;
+    Node u, v;
+    bool u_head, v_head;
+    int subside = -1; // disambiguates parallel subside edges (e.g. to the boundary)
+    Satsuma::CostFunction::Function cost_function;
+    FlowScalar lower = 0;
+    FlowScalar upper = 0;
+};
 
 struct FlowProblem {
-    std::unique_ptr<Satsuma::BiMDF> bimdf = std::make_unique<Satsuma::BiMDF>();
+    // shared, so that portfolio solves can run on after the deadline:
+    std::shared_ptr<Satsuma::BiMDF> bimdf = std::make_shared<Satsuma::BiMDF>();
+    std::map<NodeRole, Node> nodes_by_role;
+    std::vector<NodeRole> node_roles; // indexed by node id
+    std::vector<EdgeRecord> edge_records;
+    std::vector<std::array<Edge, 2>> sing_on_bound_pairs; // {capped head-head edge, parallel tail-tail edge}
     std::vector<std::array<Edge, 2>> subside_edges; // n_subsides-sized vector with corresponding bi-mdf edge(s)
     std::array<std::vector<Edge>,7> emergency_sideloops_per_valence;
     std::array<std::vector<Edge>,7> emergency_neighbor_per_valence;
@@ -51,10 +106,47 @@ struct FlowProblem {
     std::vector<Edge> unpaired_edges;
     std::vector<Edge> paired_edges;
     std::vector<Edge> pair_unaligners;
+
+    /// network reduction: quads whose sides are merged into subside chains
+    std::vector<bool> contracted_charts;
+    /// quantization of subsides that are not represented in the network (closed chains), else 0
+    std::vector<int> fixed_subside_values;
+    /// cost dropped by merging quadratic costs into one edge, add to the network cost
+    double cost_offset = 0.;
+};
+
+/// Sum of quadratic deviation costs sum_i w_i (x - t_i)^2, which equals
+/// W (x - t)^2 + const with W = sum_i w_i and t = sum_i w_i t_i / W.
+struct SubsideChain {
+    std::vector<size_t> subsides;
+    std::vector<Node> ends;
+    size_t n_terms = 0;
+    double target_sum = 0.;
+    double weight = 0.;
+    double weighted_target = 0.;
+    double weighted_sq_target = 0.;
+
+    void add_term(double target, double w) {
+        ++n_terms;
+        target_sum += target;
+        weight += w;
+        weighted_target += w * target;
+        weighted_sq_target += w * target * target;
+    }
+    double target() const {
+        return weight > 0. ? weighted_target / weight : target_sum / n_terms;
+    }
+    /// the constant part of the summed cost
+    double offset() const {
+        return weighted_sq_target - weight * target() * target();
+    }
 };
 
 #define EMERGENCY 1
 
+#define ILP_FIND_SUBDIVISION -1
+#define ILP_IGNORE -2
+
 double side_length(
         const ChartData& chart_data,
         const ChartSide& side)
@@ -118,6 +210,10 @@ static FlowProblem make_bimdf(
         const std::vector<double>& chart_edge_length,
         const Parameters& parameters,
         const SingularityPairInfo &spi,
+        /// per-subside ILP_FIND_SUBDIVISION, ILP_IGNORE or fixed value
+        const std::vector<int> &input_results,
+        /// charts that have subsides to be found, see find_active_charts
+        const std::vector<bool> &active_charts,
         /// empty or per-chart satisfaction
         const std::vector<bool> &satisfied_regularity,
         /// empty or per-pair satisfaction
@@ -132,8 +228,7 @@ static FlowProblem make_bimdf(
         if (id == -1) { // boundary
             return true;
         }
-        const Chart& chart = chart_data.charts.at(id);
-        return chart.faces.size() > 0;
+        return active_charts.at(id);
     };
 
     std::cout << "\nBi-MDF setup.\n";
@@ -162,8 +257,13 @@ static FlowProblem make_bimdf(
     // 1 edge per subside: connect incident side nodes (free)
     //
     // side nodes aid simple implementation, but increase network size.
-    //    TODO PERF: if a side has only 1 subside, we can skip the side node.
-    //    alternatively, we might want to simplify using a postprocess in libsatsuma?
+    //
+    // network reduction (flow_config.reduce_network):
+    //   an unpaired subside only needs a junction node to sum up two quadratic costs,
+    //   instead we use a single edge with the summed cost.
+    //   with flow_config.contract_quad_chains, quads that are not paired and have only
+    //   one subside per side are regular by construction: their side nodes are skipped,
+    //   opposite subsides are merged into chains that are represented by a single edge.
 
     // TODO: reserve emergency_neighbor_per_valence
     // TODO: reserve emergency_sideloops_per_valence
@@ -171,7 +271,91 @@ static FlowProblem make_bimdf(
     problem.unpaired_edges.reserve(chart_data.subsides.size()*2); // guess
     problem.paired_edges.reserve(4 * spi.paired_sides.size()); // guess, ignored quad edges
 
+    auto add_node = [&](NodeRole role) -> Node {
+        Node n = bimdf.add_node();
+        size_t id = g.id(n);
+        if (problem.node_roles.size() <= id) {
+            problem.node_roles.resize(id + 1, NodeRole{NodeRole::Kind::Boundary});
+        }
+        problem.node_roles[id] = role;
+        problem.nodes_by_role[role] = n;
+        return n;
+    };
+    auto add_edge = [&](Node u, bool u_head, Node v, bool v_head,
+                        const Satsuma::CostFunction::Function &cost_function,
+                        FlowScalar lower = 0, FlowScalar upper = BiMDF::inf(),
+                        int subside = -1) -> Edge
+    {
+        auto e = bimdf.add_edge({
+                           .u = u, .v = v,
+                           .u_head = u_head, .v_head = v_head,
+                           .cost_function = cost_function,
+                           .lower = lower,
+                           .upper = upper});
+        problem.edge_records.push_back({.edge = e, .u = u, .v = v,
+                                        .u_head = u_head, .v_head = v_head,
+                                        .subside = subside,
+                                        .cost_function = cost_function,
+                                        .lower = lower, .upper = upper});
+        return e;
+    };
+
+    if (previous_problem) {
+        // keep the network structure stable for warm starts
+        problem.contracted_charts = previous_problem->contracted_charts;
+    } else {
+        problem.contracted_charts.assign(chart_data.charts.size(), false);
+        if (flow_config.reduce_network && flow_config.contract_quad_chains) {
+            for (size_t chart_id = 0; chart_id < chart_data.charts.size(); ++chart_id) {
+                const Chart& chart = chart_data.charts[chart_id];
+                if (!should_use_chart(chart_id) || chart.chartSides.size() != 4) {
+                    continue;
+                }
+                bool contract = true;
+                for (size_t side_idx = 0; side_idx < 4; ++side_idx) {
+                    const auto &side = chart.chartSides[side_idx];
+                    if (spi.paired_sides[chart_id][side_idx]
+                            || side.subsides.size() != 1
+                            || input_results[side.subsides[0]] != ILP_FIND_SUBDIVISION) {
+                        contract = false;
+                    }
+                }
+                problem.contracted_charts[chart_id] = contract;
+            }
+        }
+    }
+    problem.fixed_subside_values.assign(chart_data.subsides.size(), 0);
+
+    // union-find over subsides, opposite sides of contracted quads are in the same chain:
+    std::vector<size_t> chain_parent(chart_data.subsides.size());
+    std::iota(chain_parent.begin(), chain_parent.end(), 0);
+    auto find_chain = [&](size_t subside_id) {
+        while (chain_parent[subside_id] != subside_id) {
+            chain_parent[subside_id] = chain_parent[chain_parent[subside_id]];
+            subside_id = chain_parent[subside_id];
+        }
+        return subside_id;
+    };
+    size_t n_contracted_charts = 0;
+    for (size_t chart_id = 0; chart_id < chart_data.charts.size(); ++chart_id) {
+        if (!problem.contracted_charts[chart_id]) {
+            continue;
+        }
+        ++n_contracted_charts;
+        const Chart& chart = chart_data.charts[chart_id];
+        for (size_t side_idx = 0; side_idx < 2; ++side_idx) {
+            size_t a = find_chain(chart.chartSides[side_idx].subsides[0]);
+            size_t b = find_chain(chart.chartSides[side_idx + 2].subsides[0]);
+            chain_parent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+    std::vector<SubsideChain> chains;
+    if (flow_config.reduce_network) {
+        chains.resize(chart_data.subsides.size());
+    }
+
     auto add_subside_edge = [&](
+            int subside_id,
             Node u, bool u_head,
             Node v, bool v_head,
             double target, double weight,
@@ -189,12 +373,8 @@ static FlowProblem make_bimdf(
         } else {
             throw std::runtime_error("unknown objective kind");
         }
-        return bimdf.add_edge({
-                           .u = u, .v = v,
-                           .u_head = u_head, .v_head = v_head,
-                           .cost_function = cf,
-                           .lower = lower, // subsides must be quantized to >= 1
-                           .upper = BiMDF::inf()});
+        // subsides must be quantized to >= 1:
+        return add_edge(u, u_head, v, v_head, cf, lower, BiMDF::inf(), subside_id);
     };
     // TODO PERF:  g.reserveNode(..); g.reserveEdge(..);
 
@@ -210,9 +390,15 @@ static FlowProblem make_bimdf(
             continue;
         }
 
+        const size_t valence = chart.chartSides.size();
+        if (problem.contracted_charts[chart_id]) {
+            chart_side_nodes[chart_id].resize(valence, lemon::INVALID);
+            chart_side_node_pairs[chart_id].resize(valence, {lemon::INVALID, lemon::INVALID});
+            continue;
+        }
+
         auto const &side_paired = spi.paired_sides[chart_id];
 
-        const size_t valence = chart.chartSides.size();
         if (valence < 3 || valence > 6) {
             assert(false);
             throw std::runtime_error(std::string("valence not handled: ") + std::to_string(valence));
@@ -256,21 +442,20 @@ static FlowProblem make_bimdf(
             assert (a != lemon::INVALID);
             assert (b != lemon::INVALID);
 
-            bimdf.add_edge({.u=a, .v=b, .u_head=false, .v_head=false,
-                            .cost_function = Satsuma::CostFunction::Zero{.guess=estimate},
-                            .lower=(valence == 4 ? 0 : 1),
-                            .upper=bimdf.inf()});
+            auto free_edge = add_edge(a, false, b, false,
+                            Satsuma::CostFunction::Zero{.guess=estimate},
+                            (valence == 4 ? 0 : 1));
             if (valence != 4 // no costs here in ILP formulation
     #if 0
                     && valence !=6 // ILP formulation only allows parity >= 6, this approximates it, but is too limiting
     #endif
                     ){
-                auto e = bimdf.add_edge({
-                                            .u=a, .v=b, .u_head=true, .v_head=true,
-                                            .cost_function = Satsuma::CostFunction::AbsDeviation{
-                                                .target=0, .weight=singularity_on_boundary_weight},
-                                            .lower=0, .upper=1});
+                auto e = add_edge(a, true, b, true,
+                                  Satsuma::CostFunction::AbsDeviation{
+                                      .target=0, .weight=singularity_on_boundary_weight},
+                                  0, 1);
                 problem.sing_on_bound_edges_per_valence[valence].push_back(e);
+                problem.sing_on_bound_pairs.push_back({e, free_edge});
 
             }
         };
@@ -298,10 +483,8 @@ static FlowProblem make_bimdf(
 
 
         auto add_emergency_tailtail = [&](Node left, Node right, double weight) -> Edge {
-            return bimdf.add_edge({.u = left, .v=right,
-                                   .u_head = false, .v_head = false,
-                                   .cost_function = Satsuma::CostFunction::AbsDeviation{.target=0, .weight=weight},
-                                   .lower = 0, .upper = bimdf.inf()});
+            return add_edge(left, false, right, false,
+                            Satsuma::CostFunction::AbsDeviation{.target=0, .weight=weight});
         };
 
         auto add_emergency_side_loop = [&](Node node, double weight) {
@@ -320,7 +503,10 @@ static FlowProblem make_bimdf(
         {
             if (side_paired[side_idx]) {
                 for (size_t i = 0; i < 2; ++i) {
-                  auto n = bimdf.add_node();
+                  auto n = add_node({.kind = NodeRole::Kind::Side,
+                                     .id = static_cast<int>(chart_id),
+                                     .idx = static_cast<int>(side_idx),
+                                     .half = static_cast<int>(i)});
                   side_node_pairs[side_idx][i] = n;
                   add_emergency_side_loop(n, emergency_side_loop_weight);
                 }
@@ -332,7 +518,9 @@ static FlowProblem make_bimdf(
                 problem.emergency_sideloops_per_valence[valence].push_back(e);
 #endif
             } else {
-                auto side_node = bimdf.add_node();
+                auto side_node = add_node({.kind = NodeRole::Kind::Side,
+                                           .id = static_cast<int>(chart_id),
+                                           .idx = static_cast<int>(side_idx)});
                 side_nodes[side_idx] = side_node;
                 add_emergency_side_loop(side_node, emergency_side_loop_weight);
             }
@@ -428,9 +616,17 @@ static FlowProblem make_bimdf(
     //std::cout << "flow: " << n_unused_charts << " unused." << std::endl;
 
 
-    Node boundary = bimdf.add_node();
+    Node boundary = add_node({.kind = NodeRole::Kind::Boundary});
     double bnd_target = 0;
 
+    auto add_chain_end = [&](SubsideChain &chain, int chart_id, int side_idx) {
+        if (chart_id == -1) {
+            chain.ends.push_back(boundary);
+        } else if (!problem.contracted_charts[chart_id]) {
+            chain.ends.push_back(chart_side_nodes[chart_id][side_idx]);
+        }
+    };
+
     for (size_t subside_id = 0; subside_id < chart_data.subsides.size(); subside_id++)
     {
         const ChartSubside& subside = chart_data.subsides.at(subside_id);
@@ -441,9 +637,36 @@ static FlowProblem make_bimdf(
         int left_side_idx = subside.incidentChartSideId[0];
         int right_side_idx = subside.incidentChartSideId[1];
 
-        if (!should_use_chart(left_chart_id) || !should_use_chart(right_chart_id)) {
-            // if this really happens, we should probably constrain all its subsides to 0?
-            std::cerr << "WARNING: should not use chart!" << std::endl;
+        const int fixed_value = input_results[subside_id];
+        if (fixed_value >= 0) {
+            // fixed by the caller (e.g. between clusters): connect the side nodes of
+            // the active charts, use the boundary node in place of inactive charts.
+            std::array<Node, 2> ends = {boundary, boundary};
+            bool any_active = false;
+            for (int i = 0; i < 2; ++i) {
+                const int chart_id = subside.incidentCharts[i];
+                if (chart_id >= 0 && should_use_chart(chart_id)) {
+                    ends[i] = chart_side_nodes[chart_id][subside.incidentChartSideId[i]];
+                    assert(ends[i] != lemon::INVALID); // sides with fixed subsides are never paired
+                    any_active = true;
+                }
+            }
+            if (!any_active) {
+                continue;
+            }
+            auto e = add_edge(ends[0], true, ends[1], true,
+                              Satsuma::CostFunction::Zero{.guess = double(fixed_value)},
+                              fixed_value, fixed_value, subside_id);
+            problem.subside_edges[subside_id][0] = e;
+            for (int i = 0; i < 2; ++i) {
+                if (ends[i] == boundary) {
+                    bnd_target += fixed_value;
+                }
+            }
+            continue;
+        }
+        if (fixed_value == ILP_IGNORE
+                || !should_use_chart(left_chart_id) || !should_use_chart(right_chart_id)) {
             continue;
         }
 
@@ -487,8 +710,15 @@ static FlowProblem make_bimdf(
                 edges[0] = add_subside_edge(left_pair[0], true, boundary, true, .5 * target, paired_subside_weight);
                 edges[1] = add_subside_edge(left_pair[1], true, boundary, true, .5 * target, paired_subside_weight);
 #endif
+            } else if (flow_config.reduce_network) {
+                auto &chain = chains[find_chain(subside_id)];
+                chain.subsides.push_back(subside_id);
+                chain.add_term(left_target, left_iso_weight);
+                add_chain_end(chain, left_chart_id, left_side_idx);
+                add_chain_end(chain, right_chart_id, right_side_idx);
+                bnd_target += left_target;
             } else {
-                edges[0] = add_subside_edge(left_single, true, boundary, true, left_target, left_iso_weight);
+                edges[0] = add_subside_edge(subside_id, left_single, true, boundary, true, left_target, left_iso_weight);
                 bnd_target += left_target;
                 problem.unpaired_edges.push_back(edges[0]);
             }
@@ -509,7 +739,9 @@ static FlowProblem make_bimdf(
 #endif
                 assert(left_side.subsides.size() == 1);
                 assert(right_side.subsides.size() == 1);
-                std::array<Node, 2> inter = {bimdf.add_node(), bimdf.add_node()};
+                std::array<Node, 2> inter = {
+                    add_node({.kind = NodeRole::Kind::Subside, .id = static_cast<int>(subside_id), .half = 0}),
+                    add_node({.kind = NodeRole::Kind::Subside, .id = static_cast<int>(subside_id), .half = 1})};
                 TargetsAndWeight left_taw, right_taw;
 
                 if (flow_config.paired_half_target == PairedHalfTarget::Half) {
@@ -564,15 +796,15 @@ static FlowProblem make_bimdf(
                 // TODO: choose which one may be zero based on target lengths and weights
                 int lower0 = 1;
                 int lower1 = 1;
-                edges[0] = add_subside_edge(inter[0], true,   left_pair[0], true,
+                edges[0] = add_subside_edge(subside_id, inter[0], true,   left_pair[0], true,
                         left_taw.targets[0], aligned_iso_scale * left_taw.weight * left_iso_weight, iso_obj, lower0);
-                edges[1] = add_subside_edge(inter[1], true,   left_pair[1], true,
+                edges[1] = add_subside_edge(subside_id, inter[1], true,   left_pair[1], true,
                         left_taw.targets[1], aligned_iso_scale * left_taw.weight * left_iso_weight, iso_obj, lower1);
 
                 // swaped array indices intentional to connect corresponding pair nodes:
-                auto other0 = add_subside_edge(inter[0], false, right_pair[1], true,
+                auto other0 = add_subside_edge(subside_id, inter[0], false, right_pair[1], true,
                         right_taw.targets[1], aligned_iso_scale * right_taw.weight * right_iso_weight, iso_obj, lower0);
-                auto other1 = add_subside_edge(inter[1], false, right_pair[0], true,
+                auto other1 = add_subside_edge(subside_id, inter[1], false, right_pair[0], true,
                         right_taw.targets[0], aligned_iso_scale * right_taw.weight * right_iso_weight, iso_obj, lower1);
                 problem.paired_edges.push_back(edges[0]);
                 problem.paired_edges.push_back(edges[1]);
@@ -581,22 +813,28 @@ static FlowProblem make_bimdf(
 
                 // allow non-alignment:
 #if 1 // disabling is just for debug
-                auto e1  = bimdf.add_edge({ .u = inter[0], .v = inter[1],
-                                            .u_head = false, .v_head = true,
-                                            .cost_function = Satsuma::CostFunction::AbsDeviation{
-                                                .target = 0, .weight = unaligned_cost * unalign_weight}});
-                auto e2  = bimdf.add_edge({ .u = inter[1], .v = inter[0],
-                                            .u_head = false, .v_head = true,
-                                            .cost_function = Satsuma::CostFunction::AbsDeviation{
-                                                .target = 0, .weight = unaligned_cost * unalign_weight}});
+                auto e1  = add_edge(inter[0], false, inter[1], true,
+                                    Satsuma::CostFunction::AbsDeviation{
+                                        .target = 0, .weight = unaligned_cost * unalign_weight});
+                auto e2  = add_edge(inter[1], false, inter[0], true,
+                                    Satsuma::CostFunction::AbsDeviation{
+                                        .target = 0, .weight = unaligned_cost * unalign_weight});
                 problem.pair_unaligners.push_back(e1);
                 problem.pair_unaligners.push_back(e2);
 #endif
 
+            } else if (!left_paired && !right_paired && flow_config.reduce_network) {
+                auto &chain = chains[find_chain(subside_id)];
+                chain.subsides.push_back(subside_id);
+                chain.add_term(left_target, left_iso_weight);
+                chain.add_term(right_target, right_iso_weight);
+                add_chain_end(chain, left_chart_id, left_side_idx);
+                add_chain_end(chain, right_chart_id, right_side_idx);
             } else if (!left_paired && !right_paired) {
-                Node inter = bimdf.add_node(); // only used to model sum of quadratic functions
-                edges[0] = add_subside_edge(left_single, true, inter, true, left_target, left_iso_weight);
-                auto other_edge = add_subside_edge(inter, false, right_single, true, right_target, right_iso_weight);
+                // only used to model sum of quadratic functions:
+                Node inter = add_node({.kind = NodeRole::Kind::Subside, .id = static_cast<int>(subside_id)});
+                edges[0] = add_subside_edge(subside_id, left_single, true, inter, true, left_target, left_iso_weight);
+                auto other_edge = add_subside_edge(subside_id, inter, false, right_single, true, right_target, right_iso_weight);
                 problem.unpaired_edges.push_back(edges[0]);
                 problem.unpaired_edges.push_back(other_edge);
             } else if (!left_paired && right_paired) {
@@ -606,12 +844,46 @@ static FlowProblem make_bimdf(
             }
         }
     }
-    [[maybe_unused]] auto bnd_loop = bimdf.add_edge({ .u = boundary,
-                     .v = boundary,
-                     .u_head = false,
-                     .v_head = false,
-                     .cost_function = Satsuma::CostFunction::Zero{.guess=bnd_target/2}
-                   });
+
+    size_t n_chains = 0;
+    for (size_t chain_id = 0; chain_id < chains.size(); ++chain_id) {
+        const SubsideChain &chain = chains[chain_id];
+        if (chain.subsides.empty()) {
+            continue;
+        }
+        ++n_chains;
+        const double target = chain.target();
+        problem.cost_offset += chain.offset();
+        if (chain.ends.size() == 2) {
+            Satsuma::CostFunction::Function cf = Satsuma::CostFunction::Zero{.guess = target};
+            if (chain.weight > 0.) {
+                cf = Satsuma::CostFunction::QuadDeviation{.target = target, .weight = chain.weight};
+            }
+            auto e = add_edge(chain.ends[0], true, chain.ends[1], true,
+                              cf, 1, BiMDF::inf(), chain_id);
+            problem.unpaired_edges.push_back(e);
+            for (const auto subside_id: chain.subsides) {
+                problem.subside_edges[subside_id][0] = e;
+            }
+        } else if (chain.ends.empty()) {
+            // closed loop of contracted quads, independent of the rest of the network:
+            int value = std::max(1, static_cast<int>(std::lround(target)));
+            problem.cost_offset += chain.weight * (value - target) * (value - target);
+            for (const auto subside_id: chain.subsides) {
+                problem.fixed_subside_values[subside_id] = value;
+            }
+        } else {
+            throw std::runtime_error("network reduction: subside chain with "
+                                     + std::to_string(chain.ends.size()) + " ends");
+        }
+    }
+    if (flow_config.reduce_network) {
+        std::cout << "\tnetwork reduction: " << n_chains << " subside chains, "
+                  << n_contracted_charts << " contracted quads.\n";
+    }
+
+    add_edge(boundary, false, boundary, false,
+             Satsuma::CostFunction::Zero{.guess=bnd_target/2});
     std::cout << "\tbimdf problem: "
               << g.maxNodeId() + 1 << " nodes, "
               << g.maxArcId() + 1 << " arcs.\n";
@@ -621,13 +893,129 @@ static FlowProblem make_bimdf(
 }
 
 
+/// Map the solution of a previous network onto a re-built one, for use as initial solution.
+///
+/// The only structural change between the two networks are dropped singularity pairs:
+/// the two nodes of a formerly paired side (or subside) are merged into one node.
+/// Merging nodes preserves flow conservation if the flow of all edges that become
+/// parallel is summed up; the alignment edges of a dropped pair become loops that
+/// enter and leave the same node and can simply be dropped.
+/// Returns nullptr if the mapped flow is not feasible for the new network.
+static std::unique_ptr<BiMDF::Solution> map_previous_solution(
+        const FlowProblem &old_problem,
+        const BiMDF::Solution &old_sol,
+        const FlowProblem &new_problem)
+{
+    const auto &bimdf = *new_problem.bimdf;
+    const auto &g = bimdf.g;
+
+    auto map_node = [&](Node old_node) -> Node {
+        NodeRole role = old_problem.node_roles.at(old_problem.bimdf->g.id(old_node));
+        auto it = new_problem.nodes_by_role.find(role);
+        if (it == new_problem.nodes_by_role.end() && role.half != -1) {
+            role.half = -1; // pair was dropped, both halves merge into one node
+            it = new_problem.nodes_by_role.find(role);
+        }
+        if (it == new_problem.nodes_by_role.end()) {
+            return lemon::INVALID;
+        }
+        return it->second;
+    };
+
+    using EdgeKey = std::tuple<int, int, int, bool, bool>;
+    auto edge_key = [&](int subside, Node u, bool u_head, Node v, bool v_head) -> EdgeKey {
+        int uid = g.id(u);
+        int vid = g.id(v);
+        if (uid > vid || (uid == vid && u_head > v_head)) {
+            std::swap(uid, vid);
+            std::swap(u_head, v_head);
+        }
+        return {subside, uid, vid, u_head, v_head};
+    };
+
+    std::map<EdgeKey, Edge> new_edges;
+    for (const auto &rec: new_problem.edge_records) {
+        new_edges[edge_key(rec.subside, rec.u, rec.u_head, rec.v, rec.v_head)] = rec.edge;
+    }
+
+    auto x0 = std::make_unique<BiMDF::Solution>(g, 0);
+    size_t n_dropped = 0;
+    for (const auto &rec: old_problem.edge_records) {
+        auto flow = old_sol[rec.edge];
+        if (flow == 0) {
+            continue;
+        }
+        Node u = map_node(rec.u);
+        Node v = map_node(rec.v);
+        if (u == lemon::INVALID || v == lemon::INVALID) {
+            // With network reduction, the junction nodes of a dropped pair are gone and
+            // the subside is a single edge. It carries the flow entering the junction.
+            auto is_junction = [&](Node n) {
+                return old_problem.node_roles.at(old_problem.bimdf->g.id(n)).kind == NodeRole::Kind::Subside;
+            };
+            bool u_gone = u == lemon::INVALID;
+            bool v_gone = v == lemon::INVALID;
+            if ((u_gone && !is_junction(rec.u)) || (v_gone && !is_junction(rec.v))) {
+                return nullptr;
+            }
+            if (u_gone && v_gone) {
+                ++n_dropped;
+                continue;
+            }
+            if (!(u_gone ? rec.u_head : rec.v_head)) {
+                continue;
+            }
+            if (rec.subside < 0) {
+                return nullptr;
+            }
+            Edge e = new_problem.subside_edges.at(rec.subside)[0];
+            if (e == lemon::INVALID) {
+                return nullptr;
+            }
+            (*x0)[e] += flow;
+            continue;
+        }
+        if (u == v && rec.u_head != rec.v_head) {
+            ++n_dropped;
+            continue;
+        }
+        auto it = new_edges.find(edge_key(rec.subside, u, rec.u_head, v, rec.v_head));
+        if (it == new_edges.end()) {
+            return nullptr;
+        }
+        (*x0)[it->second] += flow;
+    }
+
+    // Merging may push two units onto a singularity-on-boundary edge (capacity 1).
+    // Removing the excess from it and its parallel free edge keeps both nodes balanced.
+    for (const auto &[capped, free_edge]: new_problem.sing_on_bound_pairs) {
+        auto excess = (*x0)[capped] - 1;
+        if (excess > 0) {
+            (*x0)[capped] -= excess;
+            (*x0)[free_edge] -= excess;
+        }
+    }
+
+    if (!bimdf.is_valid(*x0)) {
+        return nullptr;
+    }
+    std::cout << "\twarm start: mapped previous solution, dropped flow on "
+              << n_dropped << " alignment edges." << std::endl;
+    return x0;
+}
+
+
 bool is_valid_quantisation(
         const ChartData& chart_data,
-        const std::vector<int>& lens)
+        const std::vector<int>& lens,
+        const std::vector<bool>& active_charts)
 {
     bool valid = true;
     for (size_t chart_id = 0; chart_id < chart_data.charts.size(); ++chart_id)
     {
+        if (!active_charts[chart_id]) {
+            continue;
+        }
         const Chart& chart = chart_data.charts.at(chart_id);
         size_t boundary_sum = 0;
         for (size_t side_idx = 0; side_idx < chart.chartSides.size(); side_idx++) {
@@ -660,9 +1048,6 @@ bool is_valid_quantisation(
 
 
 
-#define ILP_FIND_SUBDIVISION -1
-#define ILP_IGNORE -2
-
 template<typename Config>
 static Config get_json_config(std::string filename) {
     Config config;
@@ -693,11 +1078,213 @@ static Config get_json_config(std::string filename) {
     return config;
 }
 
-FlowResult findSubdivisionsFlow(
+/// Run all solvers concurrently on the same problem and return the cheapest valid
+/// solution that is available when the time limit (seconds, <= 0: none) or the
+/// deadline runs out. With a limit, a valid fallback solution (e.g. the previous one)
+/// competes as a candidate that is ready right away, and the approximation solvers are
+/// fallbacks as well. Satsuma cannot be interrupted, so the limit is soft by the run
+/// time of the fastest fallback. Solvers that are still running are left to finish on
+/// the BackgroundThreads, which are joined at exit.
+static PortfolioResult solve_portfolio(
+        std::shared_ptr<const BiMDF> bimdf,
+        const std::vector<SolverCandidate>& solvers,
+        const double time_limit,
+        const std::optional<Clock::time_point>& deadline,
+        std::shared_ptr<const BiMDF::Solution> x0,
+        std::shared_ptr<const BiMDF::Solution> fallback)
+{
+    std::optional<Clock::time_point> stop = deadline;
+    if (time_limit > 0.) {
+        auto limit = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(time_limit));
+        if (!stop || limit < *stop) {
+            stop = limit;
+        }
+    }
+    if (solvers.size() == 1 && !stop) {
+        return {.result = solve_bimdf(*bimdf, solvers[0].config, x0.get()),
+                .solver = 0,
+                .all_finished = true};
+    }
+
+    using Result = std::optional<Satsuma::BiMDFFullResult>;
+    std::vector<internal::PortfolioCandidate<Result>> candidates;
+    for (size_t i = 0; i < solvers.size(); ++i) {
+        auto solve = [bimdf, x0, i, config = solvers[i].config](const std::atomic<bool>& stop)
+                -> std::optional<std::pair<Result, double>> {
+            if (stop) {
+                return {};
+            }
+            try {
+                auto res = solve_bimdf(*bimdf, config, x0.get());
+                if (!bimdf->is_valid(*res.solution)) {
+                    return {};
+                }
+                const double cost = bimdf->cost(*res.solution);
+                return std::make_pair(Result{std::move(res)}, cost);
+            } catch (const std::exception &e) {
+                std::cerr << "portfolio solver " << i << " failed: " << e.what() << std::endl;
+                return {};
+            }
+        };
+        candidates.push_back({.solve = std::move(solve), .fallback = solvers[i].approximation});
+    }
+    if (stop && fallback && bimdf->is_valid(*fallback)) {
+        auto solve = [bimdf, fallback](const std::atomic<bool>&)
+                -> std::optional<std::pair<Result, double>> {
+            return std::make_pair(Result{}, bimdf->cost(*fallback));
+        };
+        candidates.push_back({.solve = std::move(solve), .fallback = true});
+    }
+
+    auto outcome = internal::runPortfolio(candidates, stop);
+    if (!outcome.result) {
+        throw std::runtime_error("solver portfolio: no solver found a valid solution");
+    }
+    const std::string winner = outcome.winner < solvers.size() ? solvers[outcome.winner].name : "fallback";
+    std::cout << "solver portfolio: " << outcome.nFinished << "/" << candidates.size() << " finished, '"
+              << winner << "' won with cost " << outcome.cost << std::endl;
+    return {.result = std::move(*outcome.result),
+            .solver = outcome.winner,
+            .all_finished = outcome.allFinished};
+}
+
+/// Charts with at least one subside to be found. All other subsides of these
+/// charts must be fixed, ILP_IGNORE is only allowed for inactive charts.
+static std::vector<bool> find_active_charts(
+        const ChartData& chart_data,
+        const std::vector<int>& input_results)
+{
+    std::vector<bool> active(chart_data.charts.size(), false);
+    for (size_t chart_id = 0; chart_id < chart_data.charts.size(); ++chart_id) {
+        const Chart& chart = chart_data.charts[chart_id];
+        if (chart.faces.empty()) {
+            continue;
+        }
+        bool has_free = false;
+        bool has_ignored = false;
+        for (size_t subside_id: chart.chartSubsides) {
+            has_free |= input_results[subside_id] == ILP_FIND_SUBDIVISION;
+            has_ignored |= input_results[subside_id] == ILP_IGNORE;
+        }
+        if (has_free && has_ignored) {
+            throw std::runtime_error("flow quantisation: chart " + std::to_string(chart_id)
+                                     + " has both ignored subsides and subsides to be found.");
+        }
+        active[chart_id] = has_free;
+    }
+    return active;
+}
+
+/// Drop singularity pairs that involve inactive charts or fixed subsides,
+/// the pairing splits subsides in two halves that can not be fixed.
+static void remove_constrained_pairs(
+        const ChartData& chart_data,
+        const std::vector<int>& input_results,
+        const std::vector<bool>& active_charts,
+        SingularityPairInfo& spi)
+{
+    auto side_is_free = [&](size_t chart_id, int side_idx) {
+        if (!active_charts[chart_id]) {
+            return false;
+        }
+        for (size_t subside_id: chart_data.charts[chart_id].chartSides.at(side_idx).subsides) {
+            if (input_results[subside_id] != ILP_FIND_SUBDIVISION) {
+                return false;
+            }
+        }
+        return true;
+    };
+    std::vector<bool> keep(spi.pairs.size(), true);
+    bool any_removed = false;
+    for (size_t pair_id = 0; pair_id < spi.pairs.size(); ++pair_id) {
+        const auto &pair = spi.pairs[pair_id];
+        bool free = side_is_free(pair.charts[0], pair.side_idx[0])
+                 && side_is_free(pair.charts[1], pair.side_idx[1]);
+        for (const auto &quad: pair.quads) {
+            free = free
+                && side_is_free(quad.chart, quad.side_idx[0])
+                && side_is_free(quad.chart, quad.side_idx[1]);
+        }
+        keep[pair_id] = free;
+        any_removed |= !free;
+    }
+    if (any_removed) {
+        spi.remove_unaligned_pairs(keep);
+    }
+}
+
+/// The first-round network and solution of the previous solve in a FlowSession.
+struct FlowWarmStart {
+    FlowProblem problem;
+    std::shared_ptr<BiMDF::Solution> solution;
+};
+
+static std::shared_ptr<BiMDF::Solution> copy_solution(
+        const FlowProblem &problem,
+        const BiMDF::Solution &sol)
+{
+    auto copy = std::make_shared<BiMDF::Solution>(problem.bimdf->g, 0);
+    for (const auto &rec: problem.edge_records) {
+        (*copy)[rec.edge] = sol[rec.edge];
+    }
+    return copy;
+}
+
+/// Export the network with the edge groups used for FlowStats.
+static BiMDFInstance to_instance(const FlowProblem &problem)
+{
+    const auto &g = problem.bimdf->g;
+    BiMDFInstance instance;
+    instance.n_nodes = static_cast<uint32_t>(g.maxNodeId() + 1);
+    instance.cost_offset = problem.cost_offset;
+    std::vector<uint32_t> edge_index(g.maxArcId() + 1, 0);
+    instance.edges.reserve(problem.edge_records.size());
+    for (const auto &rec: problem.edge_records) {
+        edge_index[g.id(rec.edge)] = static_cast<uint32_t>(instance.edges.size());
+        instance.edges.push_back({
+                .u = static_cast<uint32_t>(g.id(rec.u)),
+                .v = static_cast<uint32_t>(g.id(rec.v)),
+                .u_head = rec.u_head,
+                .v_head = rec.v_head,
+                .cost_function = rec.cost_function,
+                .lower = static_cast<int64_t>(rec.lower),
+                .upper = rec.upper == BiMDF::inf() ? BiMDFInstance::UNBOUNDED
+                                                   : static_cast<int64_t>(rec.upper)});
+    }
+    auto add_group = [&](std::string name, const std::vector<Edge> &edges) {
+        if (edges.empty()) {
+            return;
+        }
+        std::vector<uint32_t> indices;
+        indices.reserve(edges.size());
+        for (const auto &e: edges) {
+            indices.push_back(edge_index[g.id(e)]);
+        }
+        instance.edge_groups.emplace_back(std::move(name), std::move(indices));
+    };
+    add_group("unpaired", problem.unpaired_edges);
+    add_group("paired", problem.paired_edges);
+    add_group("pair_unaligners", problem.pair_unaligners);
+    for (int valence = 3; valence <= 6; ++valence) {
+        const std::string v = "_v" + std::to_string(valence);
+        add_group("emergency_sideloops" + v, problem.emergency_sideloops_per_valence[valence]);
+        add_group("emergency_neighbor" + v, problem.emergency_neighbor_per_valence[valence]);
+        add_group("sing_on_bound" + v, problem.sing_on_bound_edges_per_valence[valence]);
+    }
+    add_group("emergency_opposite_v6", problem.emergency_opposite_v6);
+    return instance;
+}
+
+static FlowResult find_subdivisions_flow_component(
         const ChartData& chart_data,
         const std::vector<double>& chart_edge_length,
         const Parameters& parameters,
-        double& out_gap,
+        const FlowConfig& flow_config,
+        const std::vector<SolverCandidate>& solvers,
+        const std::optional<Clock::time_point>& deadline,
+        FlowWarmStart *warm_start,
+        const std::string& dump_prefix,
         std::vector<int>& out_results)
 {
     using HSW = Timekeeper::HierarchicalStopWatch;
@@ -707,17 +1294,11 @@ FlowResult findSubdivisionsFlow(
     HSW sw_analysis{"analysis", sw_root};
     sw_root.resume();
 
-    auto flow_config = get_json_config<FlowConfig>(parameters.flow_config_filename);
-    auto satsuma_config = get_json_config<Satsuma::BiMDFSolverConfig>(parameters.satsuma_config_filename);
-
     std::vector<FlowStats> stats;
 
     assert(out_results.size() == chart_data.subsides.size());
-    for (size_t subside_id = 0; subside_id < out_results.size(); ++subside_id)
-    {
-        auto val = out_results[subside_id];
-        assert (val == ILP_FIND_SUBDIVISION); // we don't handle anything else yet
-    }
+    const std::vector<int> input_results = out_results;
+    const std::vector<bool> active_charts = find_active_charts(chart_data, input_results);
 
     std::vector<bool> satisfied_regularity;
     std::vector<bool> satisfied_alignment;
@@ -730,28 +1311,61 @@ FlowResult findSubdivisionsFlow(
                 PairedSides{false,false,false,false,false, false});
         spi.pairs.clear();
     }
+    remove_constrained_pairs(chart_data, input_results, active_charts, spi);
 
 
 
     std::vector<Satsuma::BiMDFFullResult> bimdf_results;
-    auto solve_and_apply = [&](FlowProblem const &problem) {
-
+    std::vector<std::string> solver_names;
+    FlowPhase stopped_in = FlowPhase::Complete;
+    size_t n_rounds = 0;
+    std::shared_ptr<const BiMDF::Solution> solution; // of the latest round
+    auto solve_and_apply = [&](FlowProblem const &problem,
+                               std::shared_ptr<const BiMDF::Solution> x0,
+                               std::shared_ptr<const BiMDF::Solution> fallback) {
+
+        if (!dump_prefix.empty()) {
+            const std::string filename = dump_prefix + "_r" + std::to_string(n_rounds) + ".bimdf";
+            saveBiMDFInstance(filename, to_instance(problem));
+            std::cout << "flow problem saved to " << filename << std::endl;
+        }
         std::cout << "\nflow problem setup complete, solving..." << std::endl;
-        auto res = solve_bimdf(*problem.bimdf, satsuma_config);
-
-        const auto &sol = *res.solution.get();
-        bimdf_results.push_back(std::move(res));
+        auto portfolio_res = solve_portfolio(problem.bimdf, solvers,
+                                             flow_config.solver_portfolio_time_limit, deadline,
+                                             x0, fallback);
+        ++n_rounds;
+        if (portfolio_res.result) {
+            const auto &winner = solvers[portfolio_res.solver];
+            solver_names.push_back(winner.name);
+            if (winner.approximation && !portfolio_res.all_finished) {
+                stopped_in = std::max(stopped_in, FlowPhase::Approximation);
+            }
+            solution = copy_solution(problem, *portfolio_res.result->solution);
+            bimdf_results.push_back(std::move(*portfolio_res.result));
+        } else {
+            std::cout << "flow: no solver finished in time, keeping the previous solution." << std::endl;
+            stopped_in = std::max(stopped_in, FlowPhase::FallbackKept);
+            solution = fallback;
+        }
+        const auto &sol = *solution;
 
         Timekeeper::ScopedStopWatch _{sw_analysis};
         if (!problem.bimdf->is_valid(sol)) {
             throw std::runtime_error("Internal error: BiMDF solution invalid");
         }
-        double bimdf_cost = problem.bimdf->cost(sol);
+        double bimdf_cost = problem.bimdf->cost(sol) + problem.cost_offset;
         std::cout << "flow solved. cost:  " << bimdf_cost << std::endl;
 
         assert(out_results.size() == chart_data.subsides.size());
         for (size_t i = 0; i < out_results.size(); ++i) {
+            if (input_results[i] != ILP_FIND_SUBDIVISION) {
+                continue;
+            }
             const auto &edges = problem.subside_edges[i];
+            if (problem.fixed_subside_values[i] > 0) {
+                out_results[i] = problem.fixed_subside_values[i];
+                continue;
+            }
 
             assert (edges[0] != lemon::INVALID);
             auto val = sol[edges[0]];
@@ -796,7 +1410,7 @@ FlowResult findSubdivisionsFlow(
         //debug_costs(problem.emergency_sideloops_per_valence[5]);
         stats.push_back(FlowStats{
                             .n_pair_unaligners_used = count_uses(problem.pair_unaligners),
-                            .cost_iso_nonpaired = sum_costs(problem.unpaired_edges),
+                            .cost_iso_nonpaired = sum_costs(problem.unpaired_edges) + problem.cost_offset,
                             .cost_iso_paired = sum_costs(problem.paired_edges),
                             .cost_regularity_neighbor_v3 = sum_costs(problem.emergency_neighbor_per_valence[3]),
                             .cost_regularity_neighbor_v4 = sum_costs(problem.emergency_neighbor_per_valence[4]),
@@ -831,7 +1445,7 @@ FlowResult findSubdivisionsFlow(
         }
 #endif
 
-        if (is_valid_quantisation(chart_data, out_results)) {
+        if (is_valid_quantisation(chart_data, out_results, active_charts)) {
             //std::cout << "\tvalidation of hard constraints successful." << std::endl;
         } else {
             throw std::runtime_error("flow quantisation resulted in infeasible result.");
@@ -856,6 +1470,10 @@ FlowResult findSubdivisionsFlow(
         size_t n_unsat_reg = 0;
         for (size_t chart_id = 0; chart_id < chart_data.charts.size(); ++chart_id)
         {
+            if (!active_charts[chart_id]) {
+                satisfied_regularity[chart_id] = true;
+                continue;
+            }
             const size_t valence = chart_data.charts[chart_id].chartSides.size();
             // NB: 1 is still okay, it means the singlarity is on the boundary
             int max_ok = valence == 4 ? 0 : 1;
@@ -924,10 +1542,24 @@ FlowResult findSubdivisionsFlow(
             chart_edge_length,
             parameters,
             spi,
+            input_results,
+            active_charts,
             satisfied_regularity);
+    std::shared_ptr<BiMDF::Solution> x0_session;
+    if (warm_start && warm_start->solution) {
+        // same topology as in the previous session solve, only costs differ:
+        x0_session = map_previous_solution(warm_start->problem, *warm_start->solution, problem);
+        if (!x0_session) {
+            std::cout << "\tflow session: previous solution does not fit, solving from scratch."
+                      << std::endl;
+        }
+    }
     sw_setup.stop();
 
-    solve_and_apply(problem);
+    solve_and_apply(problem, x0_session, x0_session);
+    if (warm_start) {
+        warm_start->solution = copy_solution(problem, *solution);
+    }
 
     sw_analysis.resume();
     std::cout << "\nflow round one finished. stats:\n"
@@ -935,8 +1567,10 @@ FlowResult findSubdivisionsFlow(
               << std::endl;
     sw_analysis.stop();
     bool updated = update_satisfaction();
-    if (updated) {
-        // TODO PERF: pass old solution as x0 (need to handle dropped alignment constraints!)
+    if (updated && deadline && Clock::now() >= *deadline) {
+        std::cout << "flow: deadline reached, skipping re-solve." << std::endl;
+        stopped_in = std::max(stopped_in, FlowPhase::ResolveSkipped);
+    } else if (updated) {
         sw_setup.resume();
         auto new_problem = make_bimdf(
                 flow_config,
@@ -944,15 +1578,32 @@ FlowResult findSubdivisionsFlow(
                 chart_edge_length,
                 parameters,
                 spi,
+                input_results,
+                active_charts,
                 satisfied_regularity,
                 &problem,
-                bimdf_results.back().solution.get());
+                solution.get());
 
+        // also the fallback if the deadline runs out during the re-solve:
+        std::shared_ptr<const BiMDF::Solution> previous;
+        if (flow_config.resolve_warm_start || deadline) {
+            previous = map_previous_solution(problem, *solution, new_problem);
+        }
+        std::shared_ptr<const BiMDF::Solution> x0;
+        if (flow_config.resolve_warm_start) {
+            x0 = previous;
+            if (!x0) {
+                std::cout << "\twarm start: previous solution could not be mapped, solving from scratch."
+                          << std::endl;
+            }
+        }
         sw_setup.stop();
-        solve_and_apply(new_problem);
+        solve_and_apply(new_problem, x0, previous);
+    }
+    if (warm_start) {
+        warm_start->problem = std::move(problem);
     }
 
-    out_gap = 0;
     sw_root.stop();
     auto sw_result = Timekeeper::HierarchicalStopWatchResult(sw_root);
     HSW sw_solve{"solve"};
@@ -965,7 +1616,273 @@ FlowResult findSubdivisionsFlow(
     sw_result.add_child(std::move(sw_solve_result));
 
     return {.bimdf_results = std::move(bimdf_results),
+            .solvers = std::move(solver_names),
+            .stats = std::move(stats),
+            .stopped_in = stopped_in,
+            .stopwatch = std::move(sw_result)};
+}
+
+/// Connected components of the active charts, connected by shared subsides that
+/// are to be found (fixed subsides do not couple charts). Components are ordered
+/// by their smallest chart id.
+static std::vector<std::vector<size_t>> chart_components(
+        const ChartData& chart_data,
+        const std::vector<int>& input_results)
+{
+    const size_t n_charts = chart_data.charts.size();
+    const std::vector<bool> active_charts = find_active_charts(chart_data, input_results);
+    std::vector<size_t> parent(n_charts);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](size_t c) {
+        while (parent[c] != c) {
+            parent[c] = parent[parent[c]];
+            c = parent[c];
+        }
+        return c;
+    };
+    auto unite = [&](size_t a, size_t b) {
+        a = find(a);
+        b = find(b);
+        parent[std::max(a, b)] = std::min(a, b);
+    };
+    for (size_t subside_id = 0; subside_id < chart_data.subsides.size(); ++subside_id) {
+        const auto &subside = chart_data.subsides[subside_id];
+        if (input_results[subside_id] == ILP_FIND_SUBDIVISION
+                && subside.incidentCharts[0] >= 0 && subside.incidentCharts[1] >= 0) {
+            unite(subside.incidentCharts[0], subside.incidentCharts[1]);
+        }
+    }
+
+    std::vector<std::vector<size_t>> components;
+    std::vector<int> component_of_root(n_charts, -1);
+    for (size_t chart_id = 0; chart_id < n_charts; ++chart_id) {
+        if (!active_charts[chart_id]) {
+            continue;
+        }
+        size_t root = find(chart_id);
+        if (component_of_root[root] < 0) {
+            component_of_root[root] = static_cast<int>(components.size());
+            components.emplace_back();
+        }
+        components[component_of_root[root]].push_back(chart_id);
+    }
+    return components;
+}
+
+/// Chart data of a subset of charts, with chart and subside ids renumbered.
+/// Charts outside of the subset become boundary.
+struct ChartComponent {
+    ChartData chart_data;
+    std::vector<double> chart_edge_length;
+    std::vector<size_t> subsides; // original subside id of each subside
+};
+
+static ChartComponent extract_component(
+        const ChartData& chart_data,
+        const std::vector<double>& chart_edge_length,
+        const std::vector<size_t>& charts)
+{
+    ChartComponent component;
+    ChartData &data = component.chart_data;
+    data.labels = chart_data.labels;
+
+    std::vector<int> chart_map(chart_data.charts.size(), -1);
+    for (size_t i = 0; i < charts.size(); ++i) {
+        chart_map[charts[i]] = static_cast<int>(i);
+    }
+    std::vector<int> subside_map(chart_data.subsides.size(), -1);
+    for (size_t chart_id: charts) {
+        for (size_t subside_id: chart_data.charts[chart_id].chartSubsides) {
+            if (subside_map[subside_id] < 0) {
+                subside_map[subside_id] = static_cast<int>(component.subsides.size());
+                component.subsides.push_back(subside_id);
+            }
+        }
+    }
+
+    data.charts.reserve(charts.size());
+    component.chart_edge_length.reserve(charts.size());
+    for (size_t chart_id: charts) {
+        Chart chart = chart_data.charts[chart_id];
+        std::vector<size_t> adjacent;
+        for (size_t adj_id: chart.adjacentCharts) {
+            if (chart_map[adj_id] >= 0) {
+                adjacent.push_back(chart_map[adj_id]);
+            }
+        }
+        chart.adjacentCharts = std::move(adjacent);
+        for (ChartSide &side: chart.chartSides) {
+            for (size_t &subside_id: side.subsides) {
+                subside_id = subside_map[subside_id];
+            }
+        }
+        for (size_t &subside_id: chart.chartSubsides) {
+            subside_id = subside_map[subside_id];
+        }
+        data.charts.push_back(std::move(chart));
+        component.chart_edge_length.push_back(chart_edge_length[chart_id]);
+    }
+
+    data.subsides.reserve(component.subsides.size());
+    for (size_t subside_id: component.subsides) {
+        ChartSubside subside = chart_data.subsides[subside_id];
+        for (int &chart_id: subside.incidentCharts) {
+            if (chart_id >= 0) {
+                chart_id = chart_map[chart_id];
+            }
+        }
+        data.subsides.push_back(std::move(subside));
+    }
+    return component;
+}
+
+FlowResult findSubdivisionsFlow(
+        const ChartData& chart_data,
+        const std::vector<double>& chart_edge_length,
+        const Parameters& parameters,
+        double& out_gap,
+        std::vector<int>& out_results,
+        FlowSession* session)
+{
+    out_gap = 0;
+    auto flow_config = get_json_config<FlowConfig>(parameters.flow_config_filename);
+    std::vector<SolverCandidate> solvers;
+    solvers.push_back({
+            .name = parameters.satsuma_config_filename.empty() ? "default" : parameters.satsuma_config_filename,
+            .config = get_json_config<Satsuma::BiMDFSolverConfig>(parameters.satsuma_config_filename)});
+    for (const auto &filename: flow_config.solver_portfolio) {
+        solvers.push_back({
+                .name = filename,
+                .config = get_json_config<Satsuma::BiMDFSolverConfig>(filename)});
+    }
+    std::optional<Clock::time_point> deadline;
+    if (flow_config.time_limit > 0.) {
+        deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(flow_config.time_limit));
+    }
+    if (flow_config.time_limit > 0. || flow_config.solver_portfolio_time_limit > 0.) {
+        for (auto &solver: solvers) {
+            if (!solver.config.refine_with_matching) {
+                solver.approximation = true;
+            }
+        }
+        if (solvers[0].config.refine_with_matching) {
+            // anytime fallback: the double-cover rounding is available long before refinement
+            SolverCandidate approximation = solvers[0];
+            approximation.name += " (approximation)";
+            approximation.config.refine_with_matching = false;
+            approximation.approximation = true;
+            solvers.push_back(std::move(approximation));
+        }
+    }
+
+    using HSW = Timekeeper::HierarchicalStopWatch;
+    HSW sw_root{"find_subdivisions_flow_components"};
+    HSW sw_split{"split", sw_root};
+    sw_root.resume();
+    sw_split.resume();
+    auto components = chart_components(chart_data, out_results);
+    sw_split.stop();
+
+    auto warm_start = [&](size_t component) -> FlowWarmStart* {
+        if (!session) {
+            return nullptr;
+        }
+        return session->warm_starts.at(component).get();
+    };
+    auto dump_prefix = [&](size_t component) -> std::string {
+        if (flow_config.dump_prefix.empty()) {
+            return {};
+        }
+        return flow_config.dump_prefix + "_c" + std::to_string(component);
+    };
+    if (session && session->warm_starts.size() != std::max<size_t>(1, components.size())) {
+        // first solve or a different layout
+        session->warm_starts.clear();
+        session->warm_starts.resize(std::max<size_t>(1, components.size()));
+        for (auto &ws: session->warm_starts) {
+            ws = std::make_shared<FlowWarmStart>();
+        }
+    }
+
+    if (components.size() <= 1) {
+        return find_subdivisions_flow_component(
+                chart_data,
+                chart_edge_length,
+                parameters,
+                flow_config,
+                solvers,
+                deadline,
+                warm_start(0),
+                dump_prefix(0),
+                out_results);
+    }
+    std::cout << "\nflow: solving " << components.size() << " chart graph components." << std::endl;
+
+    sw_split.resume();
+    std::vector<ChartComponent> component_data(components.size());
+    internal::parallelFor(components.size(), parameters.numThreads, [&](size_t i) {
+        component_data[i] = extract_component(chart_data, chart_edge_length, components[i]);
+    });
+    // largest components first, for load balancing:
+    std::vector<size_t> order(components.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return component_data[a].subsides.size() > component_data[b].subsides.size();
+    });
+    sw_split.stop();
+
+    std::vector<std::optional<FlowResult>> component_results(components.size());
+    std::vector<std::vector<int>> component_out(components.size());
+    internal::parallelFor(components.size(), parameters.numThreads, [&](size_t k) {
+        const size_t i = order[k];
+        const ChartComponent &component = component_data[i];
+        component_out[i].reserve(component.subsides.size());
+        for (size_t subside_id: component.subsides) {
+            component_out[i].push_back(out_results[subside_id]);
+        }
+        component_results[i] = find_subdivisions_flow_component(
+                component.chart_data,
+                component.chart_edge_length,
+                parameters,
+                flow_config,
+                solvers,
+                deadline,
+                warm_start(i),
+                dump_prefix(i),
+                component_out[i]);
+    });
+
+    std::vector<Satsuma::BiMDFFullResult> bimdf_results;
+    std::vector<std::string> solver_names;
+    std::vector<FlowStats> stats;
+    FlowPhase stopped_in = FlowPhase::Complete;
+    HSW sw_components{"components"};
+    auto sw_components_result = Timekeeper::HierarchicalStopWatchResult(sw_components);
+    for (size_t i = 0; i < components.size(); ++i) {
+        const ChartComponent &component = component_data[i];
+        for (size_t j = 0; j < component.subsides.size(); ++j) {
+            out_results[component.subsides[j]] = component_out[i][j];
+        }
+        auto &res = *component_results[i];
+        std::move(res.bimdf_results.begin(), res.bimdf_results.end(),
+                  std::back_inserter(bimdf_results));
+        std::move(res.solvers.begin(), res.solvers.end(),
+                  std::back_inserter(solver_names));
+        std::move(res.stats.begin(), res.stats.end(),
+                  std::back_inserter(stats));
+        stopped_in = std::max(stopped_in, res.stopped_in);
+        res.stopwatch.name = std::to_string(i);
+        sw_components_result.add_child(std::move(res.stopwatch));
+    }
+    sw_root.stop();
+    auto sw_result = Timekeeper::HierarchicalStopWatchResult(sw_root);
+    sw_result.add_child(std::move(sw_components_result));
+
+    return {.bimdf_results = std::move(bimdf_results),
+            .solvers = std::move(solver_names),
             .stats = std::move(stats),
+            .stopped_in = stopped_in,
             .stopwatch = std::move(sw_result)};
 }
 
@@ -5,6 +5,9 @@
 #include <libTimekeeper/StopWatch.hh>
 #include <libsatsuma/Extra/Highlevel.hh>
 #include <nlohmann/json.hpp>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace QuadRetopology {
 
@@ -77,16 +80,38 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(FlowStats,
                                    cost_alignment)
 
 
+/// How far the flow quantization got before FlowConfig::time_limit ran out,
+/// ordered by severity.
+enum class FlowPhase {
+    Complete,       // all solves finished
+    Approximation,  // refinement was cut off, a double-cover rounding was used
+    FallbackKept,   // no solver finished in time, the previous solution was kept
+    ResolveSkipped, // no re-solve after dropping unsatisfied constraints
+};
+
 struct FlowResult {
     std::vector<Satsuma::BiMDFFullResult> bimdf_results;
+    std::vector<std::string> solvers; // satsuma config that produced each of bimdf_results
     std::vector<FlowStats> stats;
+    FlowPhase stopped_in = FlowPhase::Complete;
     Timekeeper::HierarchicalStopWatchResult stopwatch;
 };
 
+struct FlowWarmStart;
+
+/// Keeps the flow networks of one patch layout between findSubdivisionsFlow calls,
+/// e.g. for a sweep over alpha or the scale factor. Such changes only affect
+/// targets and weights: the network topology stays the same and every solve is
+/// warm-started from the solution of the previous call.
+struct FlowSession {
+    std::vector<std::shared_ptr<FlowWarmStart>> warm_starts; // per chart graph component
+};
+
 FlowResult findSubdivisionsFlow(
         const ChartData& chartData,
         const std::vector<double>& chartEdgeLength,
         const Parameters& parameters,
         double& gap,
-        std::vector<int>& results);
+        std::vector<int>& results,
+        FlowSession* session = nullptr);
 } // namespace QuadRetopology
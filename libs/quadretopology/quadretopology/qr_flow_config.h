@@ -1,5 +1,7 @@
 #include "libsatsuma/Extra/Highlevel.hh"
 #include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
 #include <libsatsuma/Problems/BiMDF.hh>
 #include <libsatsuma/Extra/json.hh>
 
@@ -30,22 +32,49 @@ struct FlowConfigPaired{
     double unalign_weight = 1.;
 };
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(FlowConfigPaired,
-                                   iso_weight,
-                                   iso_objective,
-                                   unalign_weight)
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(FlowConfigPaired,
+                                                iso_weight,
+                                                iso_objective,
+                                                unalign_weight)
 
 struct FlowConfig {
     PairedHalfTarget paired_half_target = PairedHalfTarget::Half;
     bool paired_resolve_new_targets = false;
+    /// seed the re-solve after dropping alignment constraints with the previous solution
+    bool resolve_warm_start = true;
+    /// represent unpaired subsides by single edges instead of two edges and a junction node
+    bool reduce_network = true;
+    /// with reduce_network: enforce regularity of unpaired quads with one subside per side
+    /// and merge chains of them into single edges
+    bool contract_quad_chains = false;
+    /// further satsuma config files, solved concurrently with satsuma_config_filename;
+    /// the cheapest valid solution wins
+    std::vector<std::string> solver_portfolio;
+    /// seconds to wait for the portfolio, <= 0: wait for all solvers
+    double solver_portfolio_time_limit = 0.;
+    /// seconds for the whole flow quantization, <= 0: no limit. When it runs out,
+    /// the best solution found so far is used (see FlowResult::stopped_in). Soft limit:
+    /// a solve that has nothing to fall back on waits for the double-cover rounding
+    double time_limit = 0.;
+    /// if non-empty, every Bi-MDF network is saved as <dump_prefix>_c<component>_r<round>.bimdf
+    /// for offline solver benchmarks (see components/bimdf_bench)
+    std::string dump_prefix;
     FlowConfigPaired paired_initial;
     FlowConfigPaired paired_resolve;
 };
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(FlowConfig,
-                                   paired_half_target,
-                                   paired_resolve_new_targets,
-                                   paired_initial,
-                                   paired_resolve)
+//keys missing from a config file keep the defaults above, so older configs stay valid
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(FlowConfig,
+                                                paired_half_target,
+                                                paired_resolve_new_targets,
+                                                resolve_warm_start,
+                                                reduce_network,
+                                                contract_quad_chains,
+                                                solver_portfolio,
+                                                solver_portfolio_time_limit,
+                                                time_limit,
+                                                dump_prefix,
+                                                paired_initial,
+                                                paired_resolve)
 
 } // namespace QuadRetopology
@@ -145,7 +145,8 @@ FindSubdivisionsResult findSubdivisions(
         const std::vector<double>& chartEdgeLength,
         const Parameters& parameters,
         double& gap,
-        std::vector<int>& ilpResults)
+        std::vector<int>& ilpResults,
+        FlowSession* flowSession)
 {
     if (parameters.useFlowSolver) {
         auto res = findSubdivisionsFlow(
@@ -153,8 +154,10 @@ FindSubdivisionsResult findSubdivisions(
                 chartEdgeLength,
                 parameters,
                 gap,
-                ilpResults);
+                ilpResults,
+                flowSession);
         return {.bimdf_results = std::move(res.bimdf_results),
+                .flow_solvers = std::move(res.solvers),
                 .flow_stats = std::move(res.stats),
                 .stopwatch = std::move(res.stopwatch)};
     } else {
@@ -42,6 +42,7 @@ namespace QuadRetopology {
 
 struct FindSubdivisionsResult {
     std::vector<Satsuma::BiMDFFullResult> bimdf_results; // empty if ILP was used
+    std::vector<std::string> flow_solvers; // satsuma config per bimdf result, empty if ILP was used
     std::vector<FlowStats> flow_stats; // Empty if ILP was used
     std::vector<ILPStats> ilp_stats; // Empty if flow was used
     Timekeeper::HierarchicalStopWatchResult stopwatch;
@@ -69,7 +70,8 @@ FindSubdivisionsResult findSubdivisions(
         const std::vector<double>& chartEdgeLength,
         const Parameters& parameters,
         double& gap,
-        std::vector<int>& ilpResults);
+        std::vector<int>& ilpResults,
+        FlowSession* flowSession = nullptr);
 
 ILPResult findSubdivisions(
         const ChartData& chartData,
@@ -120,7 +122,9 @@ void quadrangulate(
         PolyMeshType& quadrangulation,
         std::vector<int>& quadrangulationFaceLabel,
         std::vector<std::vector<size_t>>& quadrangulationPartitions,
-        std::vector<std::vector<size_t>>& quadrangulationCorners);
+        std::vector<std::vector<size_t>>& quadrangulationCorners,
+        const int numThreads = 1,
+        const bool usePatternCache = false);
 
 }
 
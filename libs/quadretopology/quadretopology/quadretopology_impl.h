@@ -30,6 +30,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "includes/qr_charts.h"
 #include "includes/qr_patterns.h"
 #include "includes/qr_mapping.h"
+#include "includes/qr_parallel.h"
 #include "qr_flow.h"
 #include <map>
 
@@ -426,7 +427,13 @@ void quadrangulate(
         std::vector<std::vector<size_t>>& quadrangulationPartitions,
         std::vector<std::vector<size_t>>& quadrangulationCorners)
 {
-    return QuadRetopology::quadrangulate(
+    internal::PatternCache& patternCache = internal::PatternCache::instance();
+    if (parameters.patternCache && !parameters.patternCacheFilename.empty()) {
+        patternCache.load(parameters.patternCacheFilename);
+    }
+    const size_t numCachedPatterns = patternCache.size();
+
+    QuadRetopology::quadrangulate(
             newSurface,
             chartData,
             fixedPositionSubsides,
@@ -438,7 +445,15 @@ void quadrangulate(
             quadrangulation,
             quadrangulationFaceLabel,
             quadrangulationPartitions,
-            quadrangulationCorners);
+            quadrangulationCorners,
+            parameters.numThreads,
+            parameters.patternCache);
+
+    if (parameters.patternCache && !parameters.patternCacheFilename.empty() && patternCache.size() > numCachedPatterns) {
+        if (!patternCache.save(parameters.patternCacheFilename)) {
+            std::cout << "Warning: could not save the pattern cache to " << parameters.patternCacheFilename << std::endl;
+        }
+    }
 }
 
 template<class TriangleMeshType, class PolyMeshType>
@@ -454,7 +469,9 @@ void quadrangulate(
         PolyMeshType& quadrangulation,
         std::vector<int>& quadrangulationFaceLabel,
         std::vector<std::vector<size_t>>& quadrangulationPartitions,
-        std::vector<std::vector<size_t>>& quadrangulationCorners)
+        std::vector<std::vector<size_t>>& quadrangulationCorners,
+        const int numThreads,
+        const bool usePatternCache)
 {
     if (newSurface.face.size() <= 0)
         return;
@@ -583,17 +600,30 @@ void quadrangulate(
     }
 
 
-    //For each chart
-    for (size_t cId = 0; cId < chartData.charts.size(); cId++) {
+    //Per-chart buffers, filled independently and merged in chart order
+    struct ChartQuadrangulation {
+        bool computed = false;
+        PolyMeshType quadrangulatedChartMesh;
+        std::vector<std::vector<size_t>> patchSides;
+    };
+    std::vector<ChartQuadrangulation> chartQuadrangulations(chartData.charts.size());
+
+    //Mesh to chart vertex map of each worker, reset after each chart
+    std::vector<std::vector<int>> workerVMaps(QuadRetopology::internal::numWorkerThreads(numThreads, chartData.charts.size()));
+
+    //Quadrangulate each chart
+    patterns::initPatternTables();
+    QuadRetopology::internal::parallelForWorkers(chartData.charts.size(), numThreads, [&](const size_t cId, const size_t worker) {
         const Chart& chart = chartData.charts[cId];
+        ChartQuadrangulation& chartQuadrangulation = chartQuadrangulations[cId];
 
         if (chart.faces.size() == 0)
-            continue;
+            return;
 
         const std::vector<ChartSide>& chartSides = chart.chartSides;
         if (chartSides.size() < 3 || chartSides.size() > 6) {
             std::cout << "Chart " << cId << " with corners less than 3 or greater than 6!" << std::endl;
-            continue;
+            return;
         }
 
         bool ilpSolvedForAll = true;
@@ -604,22 +634,15 @@ void quadrangulate(
 
         if (!ilpSolvedForAll) {
             std::cout << "Chart " << cId << " not computed. ILP was not solved." << std::endl;
-            continue;
+            return;
         }
 
         //Input mesh
         Eigen::MatrixXd chartV;
         Eigen::MatrixXi chartF;
-        vcg::tri::UpdateFlags<TriangleMeshType>::FaceClearS(newSurface);
-        vcg::tri::UpdateFlags<TriangleMeshType>::VertexClearS(newSurface);
-        for (const size_t& fId : chart.faces) {
-            newSurface.face[fId].SetS();
-            for (int k = 0; k < newSurface.face[fId].VN(); k++) {
-                newSurface.face[fId].V(k)->SetS();
-            }
-        }
-        std::vector<int> vMap, fMap;
-        QuadRetopology::internal::VCGToEigen(newSurface, chartV, chartF, vMap, fMap, true, 3);
+        std::vector<size_t> chartVertices;
+        std::vector<int>& vMap = workerVMaps[worker];
+        QuadRetopology::internal::VCGToEigen(newSurface, chart.faces, chartV, chartF, chartVertices, vMap, 3);
 
         //Input subdivisions
         Eigen::VectorXi l(chartSides.size());
@@ -640,10 +663,7 @@ void quadrangulate(
                 const size_t& subSideId = chartSides[i].subsides[j];
                 const ChartSubside& subSide = chartData.subsides[subSideId];
 
-                if (ilpResult[subSideId] < 0) {
-                    std::cout << "Error: ILP not valid" << std::endl;
-                    return;
-                }
+                assert(ilpResult[subSideId] >= 0);
 
                 targetSideSubdivision += ilpResult[subSideId];
 
@@ -665,6 +685,7 @@ void quadrangulate(
 
             l(static_cast<int>(i)) = targetSideSubdivision;
         }
+        QuadRetopology::internal::resetVertexMap(chartVertices, vMap);
 
         //Pattern quadrangulation
         Eigen::MatrixXd patchV;
@@ -672,8 +693,13 @@ void quadrangulate(
         std::vector<size_t> patchBorders;
         std::vector<size_t> patchCorners;
         PolyMeshType patchMesh;
-        std::vector<std::vector<size_t>> patchSides;
-        QuadRetopology::internal::computePattern(l, patchV, patchF, patchMesh, patchBorders, patchCorners, patchSides);
+        std::vector<std::vector<size_t>>& patchSides = chartQuadrangulation.patchSides;
+        if (usePatternCache) {
+            QuadRetopology::internal::computePatternCached(l, patchV, patchF, patchMesh, patchBorders, patchCorners, patchSides);
+        }
+        else {
+            QuadRetopology::internal::computePattern(l, patchV, patchF, patchMesh, patchBorders, patchCorners, patchSides);
+        }
 
 #ifdef QUADRETOPOLOGY_DEBUG_SAVE_MESHES
         igl::writeOBJ(std::string("results/") + std::to_string(cId) + std::string("_patch.obj"), patchV, patchF);
@@ -707,7 +733,7 @@ void quadrangulate(
         assert(chartV.rows() == uvMapV.rows());
 
         //Get polymesh
-        PolyMeshType quadrangulatedChartMesh;
+        PolyMeshType& quadrangulatedChartMesh = chartQuadrangulation.quadrangulatedChartMesh;
         QuadRetopology::internal::eigenToVCG(quadrangulationV, quadrangulationF, quadrangulatedChartMesh, 4);
 
 #ifdef QUADRETOPOLOGY_DEBUG_SAVE_MESHES
@@ -723,6 +749,19 @@ void quadrangulate(
             vcg::PolygonalAlgorithm<PolyMeshType>::LaplacianReproject(quadrangulatedChartMesh, chartSmoothingIterations, 0.5, true);
         }
 
+        chartQuadrangulation.computed = true;
+    });
+
+    //Merge the charts into the quadrangulation, in chart order
+    for (size_t cId = 0; cId < chartData.charts.size(); cId++) {
+        const Chart& chart = chartData.charts[cId];
+        if (!chartQuadrangulations[cId].computed)
+            continue;
+
+        const std::vector<ChartSide>& chartSides = chart.chartSides;
+        PolyMeshType& quadrangulatedChartMesh = chartQuadrangulations[cId].quadrangulatedChartMesh;
+        const std::vector<std::vector<size_t>>& patchSides = chartQuadrangulations[cId].patchSides;
+
         std::vector<int> currentVertexMap(quadrangulatedChartMesh.vert.size(), -1);
 
         //Map subsides on the vertices of the current mesh (create if necessary)
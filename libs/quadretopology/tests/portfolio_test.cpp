@@ -0,0 +1,96 @@
+// Time limit behaviour of internal::runPortfolio, the solver race of the flow quantization.
+
+#include <quadretopology/includes/qr_portfolio.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace QuadRetopology::internal;
+using Clock = std::chrono::steady_clock;
+using Candidate = PortfolioCandidate<std::string>;
+
+namespace {
+
+int failures = 0;
+
+void check(const bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+//ignores stop, like a satsuma solve
+Candidate sleeper(const std::string& name, const double cost, const int ms,
+                  std::atomic<int>* started = nullptr)
+{
+    return {.solve = [=](const std::atomic<bool>&) -> std::optional<std::pair<std::string, double>> {
+        if (started) {
+            ++*started;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        return std::make_pair(name, cost);
+    }};
+}
+
+Candidate fallback(const std::string& name, const double cost)
+{
+    Candidate c = sleeper(name, cost, 0);
+    c.fallback = true;
+    return c;
+}
+
+double secondsSince(const Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    {
+        // a tiny limit returns on time with the fallback, the slow solver is left running
+        const auto start = Clock::now();
+        auto outcome = runPortfolio<std::string>({sleeper("slow", 1., 1000), fallback("previous", 5.)},
+                                                 start + std::chrono::milliseconds(10));
+        const double seconds = secondsSince(start);
+        check(seconds < .5, "tiny limit returned after " + std::to_string(seconds) + " s");
+        check(outcome.result && *outcome.result == "previous", "tiny limit keeps the fallback");
+        check(!outcome.allFinished, "tiny limit reports the slow solver as unfinished");
+    }
+    {
+        // a better solution found before the limit beats the fallback
+        auto outcome = runPortfolio<std::string>({sleeper("fast", 1., 10), fallback("previous", 5.)},
+                                                 Clock::now() + std::chrono::seconds(5));
+        check(outcome.result && *outcome.result == "fast", "cheapest finished candidate wins");
+        check(outcome.allFinished, "all candidates finished before the limit");
+    }
+    {
+        // after the deadline, only the fallbacks are started
+        std::atomic<int> started{0};
+        const auto start = Clock::now();
+        auto outcome = runPortfolio<std::string>({sleeper("slow", 1., 1000, &started), fallback("previous", 5.)},
+                                                 start - std::chrono::milliseconds(1));
+        check(secondsSince(start) < .5, "expired deadline returns right away");
+        check(started == 0, "expired deadline does not start the solvers");
+        check(outcome.result && *outcome.result == "previous", "expired deadline keeps the fallback");
+    }
+    {
+        // without a limit, all candidates are waited for
+        auto outcome = runPortfolio<std::string>({sleeper("a", 3., 30), sleeper("b", 2., 10)}, std::nullopt);
+        check(outcome.result && *outcome.result == "b" && outcome.allFinished, "no limit waits for all");
+    }
+
+    BackgroundThreads::instance().joinAll();
+    if (failures > 0) {
+        return 1;
+    }
+    std::cout << "portfolio tests passed" << std::endl;
+    return 0;
+}
@@ -1,12 +1,34 @@
 #include "functions.h"
 #include "trace.h"
 
+#include <mutex>
+#include <sstream>
+
+inline bool loadOutOfCore(
+        FieldTriMesh& trimesh,
+        const Parameters& parameters,
+        const std::string& meshFilename)
+{
+    //same remesher settings as remeshAndField
+    typename OutOfCoreRemesher<FieldTriMesh>::Param OPar;
+    OPar.memory_budget_mb=parameters.outOfCoreBudgetMB;
+    OPar.tmp_prefix=meshFilename.substr(0,meshFilename.find_last_of("."));
+    OPar.sharp_feature_thr=parameters.sharpAngle;
+    OPar.feature_erode_dilate=4;
+    OPar.remesher.iterations=15;
+    OPar.remesher.targetAspect=0.35;
+    OPar.remesher.targetDeltaFN=10000;
+    OPar.remesher.surfDistCheck=true;
+    return OutOfCoreRemesher<FieldTriMesh>::Remesh(meshFilename,OPar,trimesh);
+}
+
 inline void remeshAndField(
         FieldTriMesh& trimesh,
         const Parameters& parameters,
         const std::string& meshFilename,
         const std::string& sharpFilename,
-        const std::string& fieldFilename)
+        const std::string& fieldFilename,
+        bool saveData)
 {
     typename MeshPrepocess<FieldTriMesh>::BatchParam BPar;
     BPar.DoRemesh=parameters.remesh;
@@ -18,10 +40,14 @@ inline void remeshAndField(
     BPar.sharp_feature_thr=parameters.sharpAngle;
     BPar.surf_dist_check=true;
     BPar.UpdateSharp=(!parameters.hasFeature);
+    BPar.num_threads=parameters.numThreads;
+    BPar.remesh_quality_thr=parameters.remeshQualityThr;
 
     typename vcg::tri::FieldSmoother<FieldTriMesh>::SmoothParam FieldParam;
     FieldParam.alpha_curv=0.3;
     FieldParam.curv_thr=0.8;
+    FieldParam.hierarchy_faces=std::max(parameters.fieldHierarchyFaces,0);
+    FieldParam.num_threads=parameters.numThreads;
 
     if (parameters.hasFeature) {
         bool loaded=trimesh.LoadSharpFeatures(sharpFilename);
@@ -42,7 +68,43 @@ inline void remeshAndField(
         }
     }
 
-    MeshPrepocess<FieldTriMesh>::SaveAllData(trimesh,meshFilename);
+    if (saveData)
+        MeshPrepocess<FieldTriMesh>::SaveAllData(trimesh,meshFilename,parameters.binarySidecar);
+}
+
+inline void fieldToTraceMesh(
+        FieldTriMesh& trimesh,
+        TraceMesh& traceTrimesh)
+{
+    //same data that goes through the _rem.obj/.rosy/.sharp files
+    vcg::tri::Allocator<FieldTriMesh>::CompactEveryVector(trimesh);
+    traceTrimesh.Clear();
+    vcg::tri::Append<TraceMesh,FieldTriMesh>::MeshCopy(traceTrimesh,trimesh);
+    traceTrimesh.UpdateAttributes();
+
+    for (size_t i=0;i<trimesh.face.size();i++)
+    {
+        traceTrimesh.face[i].PD1().Import(trimesh.face[i].cPD1());
+        traceTrimesh.face[i].PD2().Import(trimesh.face[i].cPD2());
+        for (size_t j=0;j<3;j++)
+        {
+            if (trimesh.face[i].IsFaceEdgeS(j))
+                traceTrimesh.face[i].SetFaceEdgeS(j);
+            else
+                traceTrimesh.face[i].ClearFaceEdgeS(j);
+        }
+    }
+    vcg::tri::CrossField<TraceMesh>::OrientDirectionFaceCoherently(traceTrimesh);
+    vcg::tri::CrossField<TraceMesh>::UpdateSingularByCross(traceTrimesh,true);
+    traceTrimesh.UpdateAttributes();
+}
+
+inline void traceToTriangleMesh(
+        const TraceMesh& traceTrimesh,
+        TriangleMesh& trimeshToQuadrangulate)
+{
+    trimeshToQuadrangulate.Clear();
+    vcg::tri::Append<TriangleMesh,TraceMesh>::MeshCopy(trimeshToQuadrangulate,traceTrimesh);
 }
 
 
@@ -96,8 +158,23 @@ inline void quadrangulate(
     featureCFilename.append("_p0.c_feature");
     trimeshFeaturesC = loadFeatureCorners(featureCFilename);
     std::cout<<"Loaded "<<trimeshFeaturesC.size()<<" corner features"<<std::endl;
-    loadFeatureCorners(featureCFilename);
 
+    quadrangulateMesh(baseFilename, trimeshToQuadrangulate, quadmesh, trimeshPartitions, trimeshCorners, trimeshFeatures, trimeshFeaturesC, quadmeshPartitions, quadmeshCorners, ilpResult, parameters);
+}
+
+inline void quadrangulateMesh(
+        const std::string& baseFilename,
+        TriangleMesh& trimeshToQuadrangulate,
+        PolyMesh& quadmesh,
+        std::vector<std::vector<size_t>>& trimeshPartitions,
+        std::vector<std::vector<size_t>>& trimeshCorners,
+        std::vector<std::pair<size_t,size_t>>& trimeshFeatures,
+        std::vector<size_t>& trimeshFeaturesC,
+        std::vector<std::vector<size_t>>& quadmeshPartitions,
+        std::vector<std::vector<size_t>>& quadmeshCorners,
+        std::vector<int>& ilpResult,
+        const Parameters& parameters)
+{
     std::cout<<"Alpha: "<<parameters.alpha<<std::endl;
 
     OrientIfNeeded(trimeshToQuadrangulate,trimeshPartitions,trimeshCorners,trimeshFeatures,trimeshFeaturesC);
@@ -106,7 +183,6 @@ inline void quadrangulate(
     QuadRetopology::internal::updateAllMeshAttributes(trimeshToQuadrangulate);
 
     QuadRetopology::Parameters qParameters;
-    float scaleFactor;
     int fixedChartClusters;
 
     qParameters.alpha=parameters.alpha;
@@ -155,8 +231,6 @@ inline void quadrangulate(
 
     qParameters.hardParityConstraint=true;
 
-    scaleFactor=parameters.scaleFact;
-
     fixedChartClusters=300; //  TODO: load from parameter struct / file
     fixedChartClusters=0;
 
@@ -164,47 +238,83 @@ inline void quadrangulate(
     qParameters.quadrangulationFixedSmoothingIterations = 0; //Smoothing with fixed borders of the patches
     qParameters.quadrangulationNonFixedSmoothingIterations = 0; //Smoothing with fixed borders of the quadrangulation
     qParameters.feasibilityFix = false;
-
-    double edgeSize=avgEdge(trimeshToQuadrangulate)*scaleFactor;
-    std::cout<<"Edge size: "<<edgeSize<<std::endl;
-    const std::vector<double> edgeFactor(trimeshPartitions.size(), edgeSize);
-
-    qfp::quadrangulationFromPatches(trimeshToQuadrangulate, trimeshPartitions, trimeshCorners, edgeFactor, qParameters, fixedChartClusters, quadmesh, quadmeshPartitions, quadmeshCorners, ilpResult);
-
-    //SAVE OUTPUT
-    std::string outputFilename = baseFilename;
-    outputFilename+=std::string("_quadrangulation")+std::string(".obj");
-    vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(),0);
-
-
-    //SMOOTH
-    std::vector<size_t> QuadPart(quadmesh.face.size(),0);
-    for (size_t i=0;i<quadmeshPartitions.size();i++)
-        for (size_t j=0;j<quadmeshPartitions[i].size();j++)
-            QuadPart[quadmeshPartitions[i][j]]=i;
+    qParameters.numThreads = parameters.numThreads;
+
+    const double avgEdgeLength=avgEdge(trimeshToQuadrangulate);
+    std::vector<double> edgeSizes;
+    std::vector<std::vector<double>> edgeFactors;
+    for (float scaleFactor : parameters.scaleFact) {
+        edgeSizes.push_back(avgEdgeLength*scaleFactor);
+        edgeFactors.emplace_back(trimeshPartitions.size(), edgeSizes.back());
+        std::cout<<"Edge size: "<<edgeSizes.back()<<std::endl;
+    }
 
     std::vector<size_t> TriPart(trimeshToQuadrangulate.face.size(),0);
     for (size_t i=0;i<trimeshPartitions.size();i++)
         for (size_t j=0;j<trimeshPartitions[i].size();j++)
             TriPart[trimeshPartitions[i][j]]=i;
 
-    std::vector<size_t> QuadCornersVect;
-    for (size_t i=0;i<quadmeshCorners.size();i++)
-        for (size_t j=0;j<quadmeshCorners[i].size();j++)
-            QuadCornersVect.push_back(quadmeshCorners[i][j]);
-
-    std::sort(QuadCornersVect.begin(),QuadCornersVect.end());
-    auto last=std::unique(QuadCornersVect.begin(),QuadCornersVect.end());
-    QuadCornersVect.erase(last, QuadCornersVect.end());
-
-    std::cout<<"** SMOOTHING **"<<std::endl;
-    MultiCostraintSmooth(quadmesh,trimeshToQuadrangulate,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,0.5,edgeSize,30,1);
+    //Smoothing marks the faces of trimeshToQuadrangulate, so with several
+    //densities the outputs are smoothed and saved one at a time
+    std::mutex outputMutex;
+    auto saveQuadrangulation = [&](
+            const std::string& suffix,
+            PolyMesh& quadmesh,
+            const std::vector<std::vector<size_t>>& quadmeshPartitions,
+            const std::vector<std::vector<size_t>>& quadmeshCorners,
+            const double edgeSize)
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+
+        //SAVE OUTPUT
+        std::string outputFilename = baseFilename;
+        outputFilename+=std::string("_quadrangulation")+suffix+std::string(".obj");
+        vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, outputFilename.c_str(),0);
+
+
+        //SMOOTH
+        std::vector<size_t> QuadPart(quadmesh.face.size(),0);
+        for (size_t i=0;i<quadmeshPartitions.size();i++)
+            for (size_t j=0;j<quadmeshPartitions[i].size();j++)
+                QuadPart[quadmeshPartitions[i][j]]=i;
+
+        std::vector<size_t> QuadCornersVect;
+        for (size_t i=0;i<quadmeshCorners.size();i++)
+            for (size_t j=0;j<quadmeshCorners[i].size();j++)
+                QuadCornersVect.push_back(quadmeshCorners[i][j]);
+
+        std::sort(QuadCornersVect.begin(),QuadCornersVect.end());
+        auto last=std::unique(QuadCornersVect.begin(),QuadCornersVect.end());
+        QuadCornersVect.erase(last, QuadCornersVect.end());
+
+        std::cout<<"** SMOOTHING **"<<std::endl;
+        MultiCostraintSmooth(quadmesh,trimeshToQuadrangulate,trimeshFeatures,trimeshFeaturesC,TriPart,QuadCornersVect,QuadPart,0.5,edgeSize,30,1);
+
+        //SAVE OUTPUT
+        std::string smoothOutputFilename = baseFilename;
+        smoothOutputFilename+=std::string("_quadrangulation_smooth")+suffix+std::string(".obj");
+
+        vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, smoothOutputFilename.c_str(),0);
+    };
+
+    if (edgeFactors.size() > 1) {
+        //One quadrangulation per scale factor, saved as *_quadrangulation_s<k>.obj
+        qfp::quadrangulationsFromPatches<PolyMesh>(
+                trimeshToQuadrangulate, trimeshPartitions, trimeshCorners, edgeFactors, qParameters, fixedChartClusters,
+                [&](const size_t k,
+                    PolyMesh& quadmesh,
+                    const std::vector<std::vector<size_t>>& quadmeshPartitions,
+                    const std::vector<std::vector<size_t>>& quadmeshCorners,
+                    const std::vector<int>&)
+        {
+            saveQuadrangulation("_s" + std::to_string(k), quadmesh, quadmeshPartitions, quadmeshCorners, edgeSizes[k]);
+        });
+        return;
+    }
 
-    //SAVE OUTPUT
-    std::string smoothOutputFilename = baseFilename;
-    smoothOutputFilename+=std::string("_quadrangulation_smooth")+std::string(".obj");
+    qfp::quadrangulationFromPatches(trimeshToQuadrangulate, trimeshPartitions, trimeshCorners, edgeFactors[0], qParameters, fixedChartClusters, quadmesh, quadmeshPartitions, quadmeshCorners, ilpResult);
 
-    vcg::tri::io::ExporterOBJ<PolyMesh>::Save(quadmesh, smoothOutputFilename.c_str(),0);
+    saveQuadrangulation("", quadmesh, quadmeshPartitions, quadmeshCorners, edgeSizes[0]);
 }
 
 inline typename TriangleMesh::ScalarType avgEdge(const TriangleMesh& trimesh)
@@ -245,7 +355,33 @@ inline bool loadConfigFile(const std::string& filename, Parameters& parameters)
 
     fscanf(f,"alpha %f\n",&parameters.alpha);
 
-    fscanf(f,"scaleFact %f\n",&parameters.scaleFact);
+    std::array<char, 1024> scaleFactList = {0};
+    fscanf(f,"scaleFact %1000[^\n]\n",scaleFactList.data());
+    std::istringstream scaleFactStream(scaleFactList.data());
+    std::vector<float> scaleFact;
+    for (float s; scaleFactStream >> s;) {
+        scaleFact.push_back(s);
+    }
+    if (!scaleFact.empty()) {
+        parameters.scaleFact = scaleFact;
+    }
+
+    //optional
+    IntVar=parameters.saveIntermediate ? 1 : 0;
+    fscanf(f,"save_intermediate %d\n",&IntVar);
+    parameters.saveIntermediate=(IntVar!=0);
+
+    IntVar=parameters.binarySidecar ? 1 : 0;
+    fscanf(f,"binary_sidecar %d\n",&IntVar);
+    parameters.binarySidecar=(IntVar!=0);
+
+    fscanf(f,"num_threads %d\n",&parameters.numThreads);
+
+    fscanf(f,"field_hierarchy_faces %d\n",&parameters.fieldHierarchyFaces);
+
+    fscanf(f,"out_of_core_budget_mb %d\n",&parameters.outOfCoreBudgetMB);
+
+    fscanf(f,"remesh_quality_thr %f\n",&parameters.remeshQualityThr);
 
     fclose(f);
 
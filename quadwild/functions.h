@@ -3,6 +3,7 @@
 
 #include <triangle_mesh_type.h>
 #include <mesh_manager.h>
+#include <out_of_core_remesher.h>
 #include <vcg/space/box3.h>
 #include <tracing/mesh_type.h>
 
@@ -17,9 +18,15 @@ struct Parameters {
         remesh(true),
         sharpAngle(35),
         alpha(0.02),
-        scaleFact(1),
+        scaleFact{1},
         hasFeature(false),
-        hasField(false)
+        hasField(false),
+        saveIntermediate(false),
+        binarySidecar(false),
+        numThreads(1),
+        fieldHierarchyFaces(0),
+        outOfCoreBudgetMB(0),
+        remeshQualityThr(0)
     {
 
     }
@@ -27,17 +34,37 @@ struct Parameters {
     bool remesh;
     float sharpAngle;
     float alpha;
-    float scaleFact;
+    std::vector<float> scaleFact; //one quadrangulation per scale factor
     bool hasFeature;
     bool hasField;
+    bool saveIntermediate; //write the _rem and _p0 files of each step
+    bool binarySidecar; //write .rosy/.sharp/.patch/... in the binary sidecar format
+    int numThreads; //0: one per hardware thread
+    int fieldHierarchyFaces; //>0: solve the cross field on a proxy of about this many faces (larger meshes only)
+    int outOfCoreBudgetMB; //>0: remesh the input tile by tile within about this much memory before loading it
+    float remeshQualityThr; //>0: only remesh the triangles with a quality below this (and their neighbourhood)
 };
 
+bool loadOutOfCore(
+        FieldTriMesh& trimesh,
+        const Parameters& parameters,
+        const std::string& meshFilename);
+
 void remeshAndField(
         FieldTriMesh& trimesh,
         const Parameters& parameters,
         const std::string& meshFilename,
         const std::string& sharpFilename,
-        const std::string& fieldFilename);
+        const std::string& fieldFilename,
+        bool saveData);
+
+void fieldToTraceMesh(
+        FieldTriMesh& trimesh,
+        TraceMesh& traceTrimesh);
+
+void traceToTriangleMesh(
+        const TraceMesh& traceTrimesh,
+        TriangleMesh& trimeshToQuadrangulate);
 
 void quadrangulate(
         const std::string& path,
@@ -52,6 +79,19 @@ void quadrangulate(
         std::vector<int> ilpResult,
         const Parameters& parameters);
 
+void quadrangulateMesh(
+        const std::string& baseFilename,
+        TriangleMesh& trimeshToQuadrangulate,
+        PolyMesh& quadmesh,
+        std::vector<std::vector<size_t>>& trimeshPartitions,
+        std::vector<std::vector<size_t>>& trimeshCorners,
+        std::vector<std::pair<size_t,size_t>>& trimeshFeatures,
+        std::vector<size_t>& trimeshFeaturesC,
+        std::vector<std::vector<size_t>>& quadmeshPartitions,
+        std::vector<std::vector<size_t>>& quadmeshCorners,
+        std::vector<int>& ilpResult,
+        const Parameters& parameters);
+
 typename TriangleMesh::ScalarType avgEdge(const TriangleMesh& trimesh);
 bool loadConfigFile(const std::string& filename, Parameters& parameters);
 
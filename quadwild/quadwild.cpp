@@ -138,7 +138,12 @@ int actual_main(int argc, char* argv[])
     std::cout<<"Loading:"<<meshFilename.c_str()<<std::endl;
 
     bool allQuad;
-    bool loaded=trimesh.LoadTriMesh(meshFilename,allQuad);
+    bool loaded;
+    //a sharp feature file refers to the input faces, that are not kept by the tiled remeshing
+    if (parameters.outOfCoreBudgetMB>0 && parameters.remesh && !parameters.hasFeature && !parameters.hasField)
+        loaded=loadOutOfCore(trimesh,parameters,meshFilename);
+    else
+        loaded=trimesh.LoadTriMesh(meshFilename,allQuad);
     trimesh.UpdateDataStructures();
 
     if (!loaded)
@@ -150,7 +155,9 @@ int actual_main(int argc, char* argv[])
     std::cout<<"Loaded "<<trimesh.fn<<" faces and "<<trimesh.vn<<" vertices"<<std::endl;
 
     std::cout<<std::endl<<"--------------------- 1 - Remesh and field ---------------------"<<std::endl;
-    remeshAndField(trimesh, parameters, meshFilename, sharpFilename, fieldFilename);
+    //intermediate files are only needed if we stop early or ask for them
+    remeshAndField(trimesh, parameters, meshFilename, sharpFilename, fieldFilename,
+                   parameters.saveIntermediate || stopAfterStep == 1);
     if (stopAfterStep == 1) {
         return 0;
     }
@@ -158,13 +165,26 @@ int actual_main(int argc, char* argv[])
     std::cout<<std::endl<<"--------------------- 2 - Tracing ---------------------"<<std::endl;
 
     meshFilenamePrefix += "_rem";
-    trace(meshFilenamePrefix, traceTrimesh);
+    fieldToTraceMesh(trimesh, traceTrimesh);
+    TraceLayout traceLayout;
+    bool traced = trace(traceTrimesh, traceLayout, meshFilenamePrefix,
+                        parameters.saveIntermediate || stopAfterStep == 2,
+                        parameters.binarySidecar);
+    if (!traced) {
+        throw std::runtime_error("tracing failed");
+    }
     if (stopAfterStep == 2) {
         return 0;
     }
 
     std::cout<<std::endl<<"--------------------- 3 - Quadrangulation ---------------------"<<std::endl;
-    quadrangulate(meshFilenamePrefix + ".obj", trimeshToQuadrangulate, quadmesh, trimeshPartitions, trimeshCorners, trimeshFeatures, trimeshFeaturesC, quadmeshPartitions, quadmeshCorners, ilpResult, parameters);
+    traceToTriangleMesh(traceTrimesh, trimeshToQuadrangulate);
+    trimeshPartitions = std::move(traceLayout.partitions);
+    trimeshCorners = std::move(traceLayout.corners);
+    trimeshFeatures = std::move(traceLayout.features);
+    trimeshFeaturesC = std::move(traceLayout.featureCorners);
+    quadrangulateMesh(meshFilenamePrefix, trimeshToQuadrangulate, quadmesh, trimeshPartitions, trimeshCorners, trimeshFeatures, trimeshFeaturesC, quadmeshPartitions, quadmeshCorners, ilpResult, parameters);
+    return 0;
 }
 
 
@@ -1,6 +1,38 @@
 #include "trace.h"
 
 #include <tracing/tracer_interface.h>
+#include <cstdio>
+#include <sidecar.h>
+
+static bool loadBinaryField(TraceMesh& traceTrimesh, const std::string& filename)
+{
+    typedef typename TraceMesh::CoordType CoordType;
+    bool loaded=sidecar::loadField(filename,traceTrimesh.face.size(),[&](size_t IndexF,const double *PD1,const double *PD2)
+    {
+        traceTrimesh.face[IndexF].PD1()=CoordType(PD1[0],PD1[1],PD1[2]);
+        traceTrimesh.face[IndexF].PD2()=CoordType(PD2[0],PD2[1],PD2[2]);
+    });
+    if (!loaded)
+        return false;
+    vcg::tri::CrossField<TraceMesh>::OrientDirectionFaceCoherently(traceTrimesh);
+    vcg::tri::CrossField<TraceMesh>::UpdateSingularByCross(traceTrimesh,true);
+    return true;
+}
+
+static bool loadBinarySharpFeatures(TraceMesh& traceTrimesh, const std::string& filename)
+{
+    for (size_t i=0;i<traceTrimesh.face.size();i++)
+        for (size_t j=0;j<3;j++)
+            traceTrimesh.face[i].ClearFaceEdgeS(j);
+
+    //only the selection is used, UpdateSharpFeaturesFromSelection does the rest
+    return sidecar::loadSharp(filename,traceTrimesh.face.size(),[&](int,size_t IndexF,size_t IndexE)
+    {
+        traceTrimesh.face[IndexF].SetFaceEdgeS(IndexE);
+        if (!vcg::face::IsBorder(traceTrimesh.face[IndexF],IndexE))
+            traceTrimesh.face[IndexF].FFp(IndexE)->SetFaceEdgeS(traceTrimesh.face[IndexF].FFi(IndexE));
+    });
+}
 
 bool trace(const std::string& filename_prefix, TraceMesh& traceTrimesh)
 {
@@ -22,7 +54,9 @@ bool trace(const std::string& filename_prefix, TraceMesh& traceTrimesh)
     traceTrimesh.UpdateAttributes();
 
     //Field load
-    bool loadedField=traceTrimesh.LoadField(fieldFilename);
+    bool loadedField=sidecar::isBinary(fieldFilename) ?
+                loadBinaryField(traceTrimesh,fieldFilename) :
+                traceTrimesh.LoadField(fieldFilename);
     if (!loadedField) {
         std::cerr << "failed to load field from " << fieldFilename << std::endl;
         return false;
@@ -30,11 +64,37 @@ bool trace(const std::string& filename_prefix, TraceMesh& traceTrimesh)
     traceTrimesh.UpdateAttributes();
 
     //Sharp load
-    bool loadedFeatures=traceTrimesh.LoadSharpFeatures(sharpFilename);
+    bool loadedFeatures=sidecar::isBinary(sharpFilename) ?
+                loadBinarySharpFeatures(traceTrimesh,sharpFilename) :
+                traceTrimesh.LoadSharpFeatures(sharpFilename);
     if (!loadedFeatures) {
         std::cerr << "failed to load features from " << sharpFilename << std::endl;
         return false;
     }
+
+    TraceLayout layout;
+    return trace(traceTrimesh, layout, filename_prefix, true);
+}
+
+static void extractFeatures(const TraceMesh& traceTrimesh, TraceLayout& layout)
+{
+    //sharp edges, stored as face/edge pairs like in the .feature file
+    for (size_t i=0;i<traceTrimesh.face.size();i++)
+        for (size_t j=0;j<3;j++)
+            if (traceTrimesh.face[i].IsFaceEdgeS(j))
+                layout.features.push_back(std::pair<size_t,size_t>(i,j));
+
+    //the corners the tracer found when it set up the sharp features, the same
+    //ones SaveAllData writes to the .c_feature file
+    layout.featureCorners.assign(traceTrimesh.SharpCorners.begin(),traceTrimesh.SharpCorners.end());
+}
+
+bool trace(TraceMesh& traceTrimesh,
+           TraceLayout& layout,
+           const std::string& filename_prefix,
+           bool saveData,
+           bool binary)
+{
     traceTrimesh.SolveGeometricIssues();
     traceTrimesh.UpdateSharpFeaturesFromSelection();
 
@@ -67,6 +127,30 @@ bool trace(const std::string& filename_prefix, TraceMesh& traceTrimesh)
     PTr.InitTracer(Drift,false);
     RecursiveProcess<TracerType>(PTr,Drift, add_only_needed,final_removal,true,meta_mesh_collapse,force_split,true,false);
     PTr.SmoothPatches();
-    SaveAllData(PTr,filename_prefix,0,false,false);
+    if (saveData)
+        SaveAllData(PTr,filename_prefix,0,false,false);
+
+    //the layout indexes the mesh as it is exported, so it has to be compact
+    if ((traceTrimesh.fn!=(int)traceTrimesh.face.size())||
+        (traceTrimesh.vn!=(int)traceTrimesh.vert.size()))
+    {
+        std::cerr << "traced mesh has deleted elements" << std::endl;
+        return false;
+    }
+
+    layout.partitions=PTr.Partitions;
+    layout.corners=PTr.PartitionCorners;
+    layout.features.clear();
+    layout.featureCorners.clear();
+    extractFeatures(traceTrimesh,layout);
+
+    //the tracer only writes text, replace the layout files with binary ones
+    if (saveData && binary)
+    {
+        sidecar::savePatches(filename_prefix+"_p0.patch",layout.partitions,traceTrimesh.face.size());
+        sidecar::saveCorners(filename_prefix+"_p0.corners",layout.corners);
+        sidecar::saveFeatures(filename_prefix+"_p0.feature",layout.features);
+        sidecar::saveFeatureCorners(filename_prefix+"_p0.c_feature",layout.featureCorners);
+    }
     return true;
 }
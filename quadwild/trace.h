@@ -1,5 +1,27 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <tracing/mesh_type.h>
 
+/// Patch layout produced by the tracer, in the same form as the
+/// _p0.patch/.corners/.feature/.c_feature files.
+struct TraceLayout {
+    std::vector<std::vector<size_t>> partitions;
+    std::vector<std::vector<size_t>> corners;
+    std::vector<std::pair<size_t,size_t>> features;
+    std::vector<size_t> featureCorners;
+};
+
+/// Load <prefix>.obj/.rosy/.sharp (text or binary), trace and save the _p0 files.
 bool trace(const std::string& filename_prefix, TraceMesh& traceTrimesh);
+
+/// Trace a mesh whose field and sharp edges (face-edge selection) are
+/// already set. The traced mesh stays in traceTrimesh, the layout is
+/// returned in layout. The _p0 files are only written if saveData is set,
+/// with binary the layout files use the binary sidecar format.
+/// The feature corners are the tracer's, as in its _p0.c_feature file.
+bool trace(TraceMesh& traceTrimesh,
+           TraceLayout& layout,
+           const std::string& filename_prefix,
+           bool saveData,
+           bool binary = false);